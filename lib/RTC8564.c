@@ -14,27 +14,109 @@
 // 2013/04/14   ばんと      Ver0.1製作完了
 // 2013/04/26   ばんと      レジスタ操作関数追加&変更
 // 2013/05/07   ばんと      TIMER & ALARMのバク修正 Ver0.2
+// 2026/10/17   ばんと      読み出しを一括転送(1トランザクション)に変更
+// 2026/10/17   ばんと      レジスタ連続読み書き関数に変更
+// 2026/10/17   ばんと      制御レジスタのシャドウキャッシュ対応
+// 2026/10/17   ばんと      タイマ設定のビット操作をバッチ化
+// 2026/10/17   ばんと      ホスト(シミュレータ)でもビルドできるようにinclude整理
+// 2026/10/17   ばんと      接続するバスを指定できるようにした
+// 2026/10/17   ばんと      初期化データをプログラムメモリに置いた
+// 2026/10/17   ばんと      待ち時間をTinyWait(スリープ待ち)経由に変更
+// 2026/10/17   ばんと      ノンブロッキングの読み出し(RTC8564_now_begin/poll)追加
+// 2026/10/17   ばんと      RTC8564_now_begin() がバス使用中に読み出し中の転送先を消す不具合修正
 //------------------------------------------------------------------------
 // This code is distributed under Apache License 2.0 License
 //		which can be found at http://www.apache.org/licenses/
 //========================================================================
 
 /* Includes ------------------------------------------------------------*/
+#include <stddef.h>
+#ifdef __AVR__
 #include <avr/io.h>
-#include "delay.h"
+#include <avr/pgmspace.h>
+#endif
+#include "TinyWait.h"
 #include "TinyI2CMaster.h"
-#include "rtc8564.h"
+#include "RTC8564.h"
 
 /* local define --------------------------------------------------------*/
 /* local typedef -------------------------------------------------------*/
 /* local macro ---------------------------------------------------------*/
 /* local variables -----------------------------------------------------*/
+static TINYI2C_BUS *rtc_bus = TINYI2C_DEFAULT_BUS;    // 接続先のバス
+
+// 初期化データ(アプリケーションマニュアル P-29)
+static const uint8_t rtc_init_data[18] PROGMEM = {
+    0x00,       // write reg addr 00
+    0x20,       // 00 Control 1, STOP=1
+    0x00,       // 01 Control 2
+    0x00,       // 02 Seconds
+    0x00,       // 03 Minutes
+    0x00,       // 04 Hours
+    0x01,       // 05 Days
+    0x01,       // 06 Weekdays
+    0x01,       // 07 Months
+    0x01,       // 08 Years
+    0x80,       // 09 Minutes Alarm
+    0x80,       // 0A Hours Alarm
+    0x80,       // 0B Days Alarm
+    0x80,       // 0C Weekdays Alarm
+    0x00,       // 0D CLKOUT
+    0x00,       // 0E Timer control
+    0x00,       // 0F Timer
+    0x00        // 00 Control 1, STOP=0(START)
+};
+
+#ifdef USE_REGISTER_CACHE
+static TINYI2C_REGCACHE rtc_cache;
+
+// レジスタごとの揮発ビット(0xFF=キャッシュしない)
+static const uint8_t rtc_volatile_mask[16] PROGMEM = {
+    0x00,       // 00 Control 1
+    0x0C,       // 01 Control 2 (AF, TF)
+    0xFF,       // 02 Seconds
+    0xFF,       // 03 Minutes
+    0xFF,       // 04 Hours
+    0xFF,       // 05 Days
+    0xFF,       // 06 Weekdays
+    0xFF,       // 07 Months
+    0xFF,       // 08 Years
+    0x00,       // 09 Minutes Alarm
+    0x00,       // 0A Hours Alarm
+    0x00,       // 0B Days Alarm
+    0x00,       // 0C Weekdays Alarm
+    0x00,       // 0D CLKOUT
+    0x00,       // 0E Timer control
+    0xFF        // 0F Timer
+};
+#endif
+
+#ifdef USE_POLLED_TRANSFER
+static TINYI2C_JOB rtc_job;
+static uint8_t rtc_reg;                     // 読み出し開始レジスタ
+static uint8_t rtc_data[7];                 // 秒〜年
+static RTC_TIME *rtc_dest;                  // 読み出し完了時の格納先
+#endif
+
 /* local function prototypes -------------------------------------------*/
 static uint8_t dec2bcd(uint8_t d);
 static uint8_t bcd2dec(uint8_t b);
+static void RTC8564_decodeTime( const uint8_t *data, RTC_TIME *time );
 
 /* [ここからソース] ==================================================== */
 
+//========================================================================
+//  接続するバスの指定
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : RTCをつないだバス(指定しなければ TinyI2C_bus0)
+// 戻値: なし
+// 備考: RTC8564_init() / RTC8564_backup_return() より前に呼ぶこと
+//========================================================================
+void RTC8564_setBus( TINYI2C_BUS *bus )
+{
+    rtc_bus = bus;
+}
+
 //========================================================================
 //  convert bin to BCD
 //------------------------------------------------------------------------
@@ -89,28 +171,12 @@ int getWeekday( int nYear, int nMonth, int nDay )
 //========================================================================
 uint8_t RTC8564_init( void )
 {
-    uint8_t data[18];
-
-    data[0] = 0x00;          // write reg addr 00
-    data[1] = 0x20;          // 00 Control 1, STOP=1
-    data[2] = 0x00;          // 01 Control 2
-    data[3] = 0x00;          // 02 Seconds
-    data[4] = 0x00;          // 03 Minutes
-    data[5] = 0x00;          // 04 Hours
-    data[6] = 0x01;          // 05 Days
-    data[7] = 0x01;          // 06 Weekdays
-    data[8] = 0x01;          // 07 Months
-    data[9] = 0x01;          // 08 Years
-    data[10] = 0x80;         // 09 Minutes Alarm
-    data[11] = 0x80;         // 0A Hours Alarm
-    data[12] = 0x80;         // 0B Days Alarm
-    data[13] = 0x80;         // 0C Weekdays Alarm
-    data[14] = 0x00;         // 0D CLKOUT
-    data[15] = 0x00;         // 0E Timer control
-    data[16] = 0x00;         // 0F Timer
-    data[17] = 0x00;         // 00 Control 1, STOP=0(START)
-
-    return TinyI2C_write_data(I2C_ADDR_RTC8564, data, sizeof(data), SEND_STOP);
+#ifdef USE_REGISTER_CACHE
+    // 全レジスタを書き換えるのでキャッシュは空から始める
+    TinyI2C_cache_attach(&rtc_cache, rtc_bus, I2C_ADDR_RTC8564, 0x00, sizeof(rtc_volatile_mask), rtc_volatile_mask);
+#endif
+
+    return TinyI2C_write_data_P(rtc_bus, I2C_ADDR_RTC8564, rtc_init_data, sizeof(rtc_init_data), SEND_STOP);
 }
 
 //========================================================================
@@ -121,7 +187,7 @@ uint8_t RTC8564_init( void )
 //========================================================================
 uint8_t RTC8564_power_on( void )
 {
-    wait_sec(1);
+    TinyWait_sec(1);
 
     return RTC8564_init();
 
@@ -138,8 +204,12 @@ uint8_t RTC8564_backup_return( void )
     uint8_t data;
     uint8_t status;
 
+#ifdef USE_REGISTER_CACHE
+    TinyI2C_cache_attach(&rtc_cache, rtc_bus, I2C_ADDR_RTC8564, 0x00, sizeof(rtc_volatile_mask), rtc_volatile_mask);
+#endif
+
     // Seconds レジスタ
-    status = TinyI2C_readReg( I2C_ADDR_RTC8564, 0x02, &data );
+    status = TinyI2C_readReg( rtc_bus, I2C_ADDR_RTC8564, 0x02, &data );
     if(status != TINYI2C_NO_ERROR)
     {
         return status;
@@ -161,7 +231,7 @@ uint8_t RTC8564_backup_return( void )
 //========================================================================
 uint8_t RTC8564_adjust( const RTC_TIME *time )
 {
-    uint8_t data[8];
+    uint8_t data[7];
     uint8_t status;
 
     // RTC8564 停止
@@ -170,26 +240,25 @@ uint8_t RTC8564_adjust( const RTC_TIME *time )
     {
         return status;
     }
-    //
-    data[0] = 0x02;          // レジスタテーブル アドレス(秒)
-    data[1] = dec2bcd(time->sec);    // 秒
-    data[2] = dec2bcd(time->min);    // 分
-    data[3] = dec2bcd(time->hour);   // 時
-    data[4] = dec2bcd(time->day);    // 日
-    data[5] = dec2bcd(time->wday);   // 曜日
-    data[6] = dec2bcd(time->month);  // 月
+    // 秒レジスタ(0x02)から連続書き込み
+    data[0] = dec2bcd(time->sec);    // 秒
+    data[1] = dec2bcd(time->min);    // 分
+    data[2] = dec2bcd(time->hour);   // 時
+    data[3] = dec2bcd(time->day);    // 日
+    data[4] = dec2bcd(time->wday);   // 曜日
+    data[5] = dec2bcd(time->month);  // 月
 
     if (time->year >= 2100)
     {
-        data[7] = dec2bcd(time->year - 2100);   // 年
-		data[6] |= 0x80;						// 世紀フラッグセット
+        data[6] = dec2bcd(time->year - 2100);   // 年
+		data[5] |= 0x80;						// 世紀フラッグセット
     }
     else
     {
-        data[7] = dec2bcd(time->year - 2000);   // 年
+        data[6] = dec2bcd(time->year - 2000);   // 年
     }
 
-    status = TinyI2C_write_data(I2C_ADDR_RTC8564, data, sizeof(data), SEND_STOP);
+    status = TinyI2C_writeRegs(rtc_bus, I2C_ADDR_RTC8564, 0x02, TINYI2C_REG8, data, sizeof(data));
     if(status != TINYI2C_NO_ERROR)
     {
         return status;
@@ -211,19 +280,78 @@ uint8_t RTC8564_now( RTC_TIME *time )
     uint8_t data[7];
     uint8_t status;
 
-    /* 読み込むアドレスの登録 */
-    data[0] = 0x02;          // レジスタテーブル アドレス(秒)
-    status = TinyI2C_write_data(I2C_ADDR_RTC8564, data, 1, NO_SEND_STOP);
+    /* 秒レジスタ(0x02)から連続読み込み */
+    status = TinyI2C_readRegs(rtc_bus, I2C_ADDR_RTC8564, 0x02, TINYI2C_REG8, data, sizeof(data));
     if(status != TINYI2C_NO_ERROR)
     {
         return status;
     }
-    status = TinyI2C_read_data(I2C_ADDR_RTC8564, data, 7, SEND_STOP);
-    if(status != TINYI2C_NO_ERROR)
+
+    RTC8564_decodeTime(data, time);
+
+    return status;
+}
+
+#ifdef USE_POLLED_TRANSFER
+//========================================================================
+// 時計・カレンダの読み出し開始(ノンブロッキング)
+//------------------------------------------------------------------------
+// 引数: RTC_TIME *time: 取得する日時のデータ(完了まで保持すること)
+// 戻値: 0=開始 TINYI2C_BUSY=バスで別の転送を進めている
+// 備考: 完了するまで RTC8564_poll() を繰り返し呼ぶこと
+//========================================================================
+uint8_t RTC8564_now_begin( RTC_TIME *time )
+{
+    uint8_t status;
+
+    status = TinyI2C_begin(rtc_bus, &rtc_job);  // 読み出し中の転送先は書き換えない
+    if (status != TINYI2C_NO_ERROR)
     {
         return status;
     }
 
+    rtc_reg = 0x02;                         // 秒レジスタから
+    rtc_dest = time;
+    rtc_job.slave_7bit_addr = I2C_ADDR_RTC8564;
+    rtc_job.wdata = &rtc_reg;
+    rtc_job.wsize = 1;
+    rtc_job.rdata = rtc_data;
+    rtc_job.rsize = sizeof(rtc_data);
+    rtc_job.callback = NULL;
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+// ノンブロッキング読み出しを進める
+//------------------------------------------------------------------------
+// 引数: なし
+// 戻値: TINYI2C_BUSY=読み出し中 0=完了(日時を格納済み) それ以外I2C通信エラー
+//========================================================================
+uint8_t RTC8564_poll( void )
+{
+    uint8_t status;
+
+    status = TinyI2C_poll(rtc_bus);
+    if (status == TINYI2C_NO_ERROR && rtc_dest != NULL)
+    {
+        RTC8564_decodeTime(rtc_data, rtc_dest);
+        rtc_dest = NULL;
+    }
+
+    return status;
+}
+#endif
+
+//========================================================================
+// 読み出したレジスタ(秒〜年)を日時に変換
+//------------------------------------------------------------------------
+// 引数: const uint8_t *data : 秒レジスタ(0x02)からの7バイト
+//       RTC_TIME *time      : 変換した日時
+// 戻値: なし
+//========================================================================
+static void RTC8564_decodeTime( const uint8_t *data, RTC_TIME *time )
+{
     time->sec  = bcd2dec( data[0] & 0x7F );
     time->min  = bcd2dec( data[1] & 0x7F );
     time->hour = bcd2dec( data[2] & 0x3F );
@@ -239,8 +367,6 @@ uint8_t RTC8564_now( RTC_TIME *time )
     {
         time->year = bcd2dec( data[6] ) + 2000;
     }
-
-    return status;
 }
 
 #ifdef USE_ALARM
@@ -257,66 +383,57 @@ uint8_t RTC8564_now( RTC_TIME *time )
 //========================================================================
 uint8_t RTC8564_setTimer( enum RTC_TIMER_TIMING sclk, uint8_t count, uint8_t cycle, uint8_t int_out )
 {
-    uint8_t data[2];
     uint8_t status;
+    TINYI2C_BATCH batch;
+
+    TinyI2C_batch_init( &batch, rtc_bus, I2C_ADDR_RTC8564 );
 
     // タイマ割り込み停止(TE = 0)
-    status = TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x0E, _BV(7) );
-    if(status != TINYI2C_NO_ERROR)
-    {
-        return status;
-    }
+    TinyI2C_batch_clearRegBit( &batch, 0x0E, _BV(7) );
 
     // 割り込み解除( TIE=0, TF=0 )
-    status = TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x01, _BV(2) | _BV(0) );
-    if(status != TINYI2C_NO_ERROR)
-    {
-        return status;
-    }
+    TinyI2C_batch_clearRegBit( &batch, 0x01, _BV(2) | _BV(0) );
 
     if ( cycle )
     {
         // 繰り返し割り込み( TI/TP = 1 )
-        status = TinyI2C_setRegBit( I2C_ADDR_RTC8564, 0x01, _BV(4) );
+        TinyI2C_batch_setRegBit( &batch, 0x01, _BV(4) );
     }
     else
     {
         // 一度きりの割り込み( TI/TP = 0 )
-        status = TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x01, _BV(4) );
+        TinyI2C_batch_clearRegBit( &batch, 0x01, _BV(4) );
     }
 
     if ( int_out )
     {
         // /INT "LOW"レベル割り込み出力許可( TIE = 1 )
-        status = TinyI2C_setRegBit( I2C_ADDR_RTC8564, 0x01, _BV(0) );
+        TinyI2C_batch_setRegBit( &batch, 0x01, _BV(0) );
     }
     else
     {
         // /INT "LOW"レベル割り込み出力不許可( TIE = 0 )
-        status = TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x01, _BV(0) );
-    }
-    if(status != TINYI2C_NO_ERROR)
-    {
-        return status;
+        TinyI2C_batch_clearRegBit( &batch, 0x01, _BV(0) );
     }
 
     // タイマカウントダウン周期設定
-    status = TinyI2C_masksetRegBit( I2C_ADDR_RTC8564, 0x0E, _BV(1) | _BV(0), sclk );
+    TinyI2C_batch_masksetRegBit( &batch, 0x0E, _BV(1) | _BV(0), sclk );
+
+    // 0x01〜0x0Eを1回読み込み、0x0E → 0x01 の順に書き戻す
+    status = TinyI2C_batch_commit( &batch );
     if(status != TINYI2C_NO_ERROR)
     {
         return status;
     }
 
-    // タイマカウンタ値設定
-    data[0] = 0x0F;          // タイマーのレジスタ・アドレス
-    data[1] = count;         // カウントダウンタイマ値設定
-    status = TinyI2C_write_data(I2C_ADDR_RTC8564, data, 2, SEND_STOP);
+    // タイマカウンタ値設定(タイマーのレジスタ・アドレス 0x0F)
+    status = TinyI2C_writeRegs(rtc_bus, I2C_ADDR_RTC8564, 0x0F, TINYI2C_REG8, &count, 1);
     if(status != TINYI2C_NO_ERROR)
     {
         return status;
     }
 
-    return TinyI2C_setRegBit( I2C_ADDR_RTC8564, 0x0E, _BV(7) );    // タイマ割り込み許可(TE = 1)
+    return TinyI2C_setRegBit( rtc_bus, I2C_ADDR_RTC8564, 0x0E, _BV(7) );    // タイマ割り込み許可(TE = 1)
 }
 
 //========================================================================
@@ -327,17 +444,17 @@ uint8_t RTC8564_setTimer( enum RTC_TIMER_TIMING sclk, uint8_t count, uint8_t cyc
 //========================================================================
 uint8_t RTC8564_stopTimer( void )
 {
-    uint8_t status;
+    TINYI2C_BATCH batch;
+
+    TinyI2C_batch_init( &batch, rtc_bus, I2C_ADDR_RTC8564 );
 
 	// タイマ割り込み停止(TE = 0)
-	status = TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x0E, _BV(7) );
-    if(status != TINYI2C_NO_ERROR)
-    {
-		return status;
-	}
+	TinyI2C_batch_clearRegBit( &batch, 0x0E, _BV(7) );
 
 	// 割り込み解除およびフラッグクリア( TIE=0, TF=0 )
-	return TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x01, _BV(2) | _BV(0) );
+	TinyI2C_batch_clearRegBit( &batch, 0x01, _BV(2) | _BV(0) );
+
+	return TinyI2C_batch_commit( &batch );
 
 }
 
@@ -349,7 +466,7 @@ uint8_t RTC8564_stopTimer( void )
 //========================================================================
 uint8_t RTC8564_clearTimer( void )
 {
-	return TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x01, _BV(2) );
+	return TinyI2C_clearRegBit( rtc_bus, I2C_ADDR_RTC8564, 0x01, _BV(2) );
 }
 
 //========================================================================
@@ -360,65 +477,63 @@ uint8_t RTC8564_clearTimer( void )
 //========================================================================
 uint8_t RTC8564_setAlarm( ALARM_TIME *alarm )
 {
-    uint8_t data[5];
+    uint8_t data[4];
     uint8_t status;
 
-    // アラーム割り込み停止(AE = 1)
-    data[0] = 0x09;         // Minute Alarmレジスタ・アドレス
-    data[1] = 0x80;         // Minute Alarm (AE=1)
-    data[2] = 0x80;         // Hour Alarm (AE=1)
-    data[3] = 0x80;         // Day Alarm (AE=1)
-    data[4] = 0x80;         // Week Day Alarm (AE=1)
-    status = TinyI2C_write_data(I2C_ADDR_RTC8564, data, 5, SEND_STOP);
+    // アラーム割り込み停止(AE = 1) Minute Alarmレジスタ(0x09)から
+    data[0] = 0x80;         // Minute Alarm (AE=1)
+    data[1] = 0x80;         // Hour Alarm (AE=1)
+    data[2] = 0x80;         // Day Alarm (AE=1)
+    data[3] = 0x80;         // Week Day Alarm (AE=1)
+    status = TinyI2C_writeRegs(rtc_bus, I2C_ADDR_RTC8564, 0x09, TINYI2C_REG8, data, sizeof(data));
     if(status != TINYI2C_NO_ERROR)
     {
         return status;
     }
 
     // 割り込み解除( AIE=0, AF=0 )
-    status = TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x01, _BV(3) | _BV(1) );
+    status = TinyI2C_clearRegBit( rtc_bus, I2C_ADDR_RTC8564, 0x01, _BV(3) | _BV(1) );
     if(status != TINYI2C_NO_ERROR)
     {
         return status;
     }
 
-    data[0] = 0x09;              // 分アラームレジスタ・アドレス
     // 毎分設定
-    data[1] = dec2bcd(alarm->min & 0x7F);
+    data[0] = dec2bcd(alarm->min & 0x7F);
     if(alarm->min & 0x80)
     {
-        data[1] |= 0x80;
+        data[0] |= 0x80;
     }
 
     // 毎時設定
-    data[2] = dec2bcd(alarm->hour & 0x7F);
+    data[1] = dec2bcd(alarm->hour & 0x7F);
     if(alarm->hour & 0x80)
     {
-        data[2] |= 0x80;
+        data[1] |= 0x80;
     }
 
     // 毎日設定
-    data[3] = dec2bcd(alarm->day & 0x7F);
+    data[2] = dec2bcd(alarm->day & 0x7F);
     if(alarm->day & 0x80)
     {
-        data[3] |= 0x80;
+        data[2] |= 0x80;
     }
 
     // 毎曜日設定
-    data[4] = dec2bcd(alarm->wday & 0x7F);
+    data[3] = dec2bcd(alarm->wday & 0x7F);
     if(alarm->wday & 0x80)
     {
-        data[4] |= 0x80;
+        data[3] |= 0x80;
     }
 
-    status = TinyI2C_write_data(I2C_ADDR_RTC8564, data, 5, SEND_STOP);
+    status = TinyI2C_writeRegs(rtc_bus, I2C_ADDR_RTC8564, 0x09, TINYI2C_REG8, data, sizeof(data));
     if(status != TINYI2C_NO_ERROR)
     {
         return status;
     }
 
     // 割り込み許可(AIE=1)
-    return TinyI2C_setRegBit( I2C_ADDR_RTC8564, 0x01, _BV(1) );
+    return TinyI2C_setRegBit( rtc_bus, I2C_ADDR_RTC8564, 0x01, _BV(1) );
 }
 
 //========================================================================
@@ -432,14 +547,8 @@ uint8_t RTC8564_getAlarm( ALARM_TIME *alarm )
     uint8_t data[4];
     uint8_t status;
 
-    /* 読み込むアドレスの登録 */
-    data[0] = 0x09;          // レジスタテーブル アドレス(秒)
-    status = TinyI2C_write_data(I2C_ADDR_RTC8564, data, 1, NO_SEND_STOP);
-    if(status != TINYI2C_NO_ERROR)
-    {
-        return status;
-    }
-    status = TinyI2C_read_data(I2C_ADDR_RTC8564, data, 4, SEND_STOP);
+    /* 分アラームレジスタ(0x09)から連続読み込み */
+    status = TinyI2C_readRegs(rtc_bus, I2C_ADDR_RTC8564, 0x09, TINYI2C_REG8, data, sizeof(data));
     if(status != TINYI2C_NO_ERROR)
     {
         return status;
@@ -480,12 +589,12 @@ uint8_t RTC8564_getAlarm( ALARM_TIME *alarm )
 //========================================================================
 uint8_t RTC8564_stopAlarm( void )
 {
-    uint8_t data[5];
+    uint8_t data[4];
     uint8_t status;
     ALARM_TIME alarm;
 
 	// 割り込み解除( AIE=0, AF=0 )
-	status = TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x01, _BV(3) | _BV(1) );
+	status = TinyI2C_clearRegBit( rtc_bus, I2C_ADDR_RTC8564, 0x01, _BV(3) | _BV(1) );
     if(status != TINYI2C_NO_ERROR)
     {
 		return status;
@@ -497,13 +606,12 @@ uint8_t RTC8564_stopAlarm( void )
         return status;
     }
 
-    // アラーム割り込み停止(AE = 1)
-    data[0] = 0x09;         // Minute Alarmレジスタ・アドレス
-    data[1] = dec2bcd(alarm.min  & 0x7F) | 0x80;         // Minute Alarm (AE=1)
-    data[2] = dec2bcd(alarm.hour & 0x7F) | 0x80;         // Hour Alarm (AE=1)
-    data[3] = dec2bcd(alarm.day  & 0x7F) | 0x80;         // Day Alarm (AE=1)
-    data[4] = dec2bcd(alarm.wday & 0x7F) | 0x80;         // Week Day Alarm (AE=1)
-    return TinyI2C_write_data(I2C_ADDR_RTC8564, data, 5, SEND_STOP);
+    // アラーム割り込み停止(AE = 1) Minute Alarmレジスタ(0x09)から
+    data[0] = dec2bcd(alarm.min  & 0x7F) | 0x80;         // Minute Alarm (AE=1)
+    data[1] = dec2bcd(alarm.hour & 0x7F) | 0x80;         // Hour Alarm (AE=1)
+    data[2] = dec2bcd(alarm.day  & 0x7F) | 0x80;         // Day Alarm (AE=1)
+    data[3] = dec2bcd(alarm.wday & 0x7F) | 0x80;         // Week Day Alarm (AE=1)
+    return TinyI2C_writeRegs(rtc_bus, I2C_ADDR_RTC8564, 0x09, TINYI2C_REG8, data, sizeof(data));
 }
 
 //========================================================================
@@ -514,7 +622,7 @@ uint8_t RTC8564_stopAlarm( void )
 //========================================================================
 uint8_t RTC8564_clearAlarm( void )
 {
-	return TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x01, _BV(3) );
+	return TinyI2C_clearRegBit( rtc_bus, I2C_ADDR_RTC8564, 0x01, _BV(3) );
 }
 #endif
 
@@ -528,12 +636,34 @@ uint8_t RTC8564_setClkOut( enum  RTC_CLKOUT_FREQ clkout )
 {
     if( clkout == FREQ_0 )
     {
-        return TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x0D, _BV(7) );
+        return TinyI2C_clearRegBit( rtc_bus, I2C_ADDR_RTC8564, 0x0D, _BV(7) );
     }
     else
     {
-        return TinyI2C_masksetRegBit( I2C_ADDR_RTC8564, 0x0D, _BV(7) | _BV(1) | _BV(0), _BV(7) | clkout );
+        return TinyI2C_masksetRegBit( rtc_bus, I2C_ADDR_RTC8564, 0x0D, _BV(7) | _BV(1) | _BV(0), _BV(7) | clkout );
     }
 }
 
+//========================================================================
+//  時計の開始
+//------------------------------------------------------------------------
+// 引数: なし
+// 戻値: 0=正常終了 それ以外I2C通信エラー
+//========================================================================
+uint8_t RTC8564_start( void )
+{
+    return TinyI2C_clearRegBit( rtc_bus, I2C_ADDR_RTC8564, 0x00, _BV(7) | _BV(5) | _BV(3) );
+}
+
+//========================================================================
+//  時計の停止
+//------------------------------------------------------------------------
+// 引数: なし
+// 戻値: 0=正常終了 それ以外I2C通信エラー
+//========================================================================
+uint8_t RTC8564_stop( void )
+{
+    return TinyI2C_masksetRegBit( rtc_bus, I2C_ADDR_RTC8564, 0x00, _BV(7) | _BV(5) | _BV(3), _BV(5) );
+}
+
 /* =====================================================[ここまでソース] */
@@ -13,6 +13,8 @@
 // 2013/04/13   ばんと      製作開始
 // 2013/04/14   ばんと      Ver0.1製作完了
 // 2013/05/07   ばんと      TIMER & ALARMのバク修正 Ver0.2
+// 2026/10/17   ばんと      接続するバスを指定できるようにした
+// 2026/10/17   ばんと      ノンブロッキングの読み出し(RTC8564_now_begin/poll)追加
 //------------------------------------------------------------------------
 // This code is distributed under Apache License 2.0 License
 //		which can be found at http://www.apache.org/licenses/
@@ -21,6 +23,8 @@
 #ifndef __RTC8564_H_
 #define __RTC8564_H_
 
+#include "TinyI2CMaster.h"
+
 /* define --------------------------------------------------------------*/
 #define	I2C_ADDR_RTC8564	0x51	//Slave address=1010001
 
@@ -53,11 +57,16 @@ typedef struct
 /* variables -----------------------------------------------------------*/
 /* function prototypes -------------------------------------------------*/
 int getWeekday( int nYear, int nMonth, int nDay );
+void RTC8564_setBus( TINYI2C_BUS *bus );
 uint8_t RTC8564_init( void );
 uint8_t RTC8564_power_on( void );
 uint8_t RTC8564_backup_return( void );
 uint8_t RTC8564_adjust( const RTC_TIME *time );
 uint8_t RTC8564_now( RTC_TIME *time );
+#ifdef USE_POLLED_TRANSFER
+uint8_t RTC8564_now_begin( RTC_TIME *time );
+uint8_t RTC8564_poll( void );
+#endif
 
 #ifdef USE_ALARM
 uint8_t RTC8564_setTimer( enum RTC_TIMER_TIMING sclk, uint8_t count, uint8_t cycle, uint8_t int_out );
@@ -70,7 +79,7 @@ uint8_t RTC8564_clearAlarm( void );
 
 uint8_t RTC8564_setClkOut( enum  RTC_CLKOUT_FREQ clkout );
 
-#define RTC8564_start() TinyI2C_clearRegBit( I2C_ADDR_RTC8564, 0x00, _BV(7) | _BV(5) | _BV(3) )
-#define RTC8564_stop() TinyI2C_masksetRegBit( I2C_ADDR_RTC8564, 0x00, _BV(7) | _BV(5) | _BV(3), _BV(5) )
+uint8_t RTC8564_start( void );
+uint8_t RTC8564_stop( void );
 
 #endif	/*  #ifndef */
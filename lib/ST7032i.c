@@ -11,15 +11,35 @@
 // When         Who         Description of change
 // -----------  ----------- -----------------------
 // 2013/02/06   ばんと      修正完了
+// 2026/10/17   ばんと      ホスト(シミュレータ)でもビルドできるようにinclude整理
+// 2026/10/17   ばんと      接続するバスを指定できるようにした
+// 2026/10/17   ばんと      独自のリトライをやめてバスのリトライ方針に一本化
+// 2026/10/17   ばんと      ST7032i_puts_p を1トランザクションで送るようにした
+// 2026/10/17   ばんと      待ち時間をTinyWait(スリープ待ち)経由に変更
+// 2026/10/17   ばんと      ノンブロッキングの文字列表示(ST7032i_puts_begin/poll)追加
+// 2026/10/17   ばんと      フレームバッファと変わった文字だけ送る ST7032i_flush() 追加
+// 2026/10/17   ばんと      命令をCo=1でつないで1回で送るバッチ追加 初期化の待ちをデータシートの値に
+// 2026/10/17   ばんと      命令ごとの固定待ちをやめ、実行時間が残っているときだけ次の送信前に待つ
+// 2026/10/17   ばんと      命令と文字をキューに積んで後から送る描画キュー追加
+// 2026/10/17   ばんと      ユーザ文字を1回の転送で書くようにした CGRAMのLRUキャッシュ追加
+// 2026/10/17   ばんと      ST7032i_puts_begin() で待たない(実行待ちはポーリング転送の開始を遅らせる)
+// 2026/10/17   ばんと      命令バッチ: 長い命令(クリア/ホーム)の後には追加できない WriteCmdsはそこで転送を分ける
+// 2026/10/17   ばんと      実行待ちを待ち終わったら忘れる(時計が1周すると32ms余分に待つ不具合修正)
+// 2026/10/17   ばんと      キュー送信の失敗を返す(非同期でLCDが応答しないと止まる不具合修正) 設定関数は結果を返し、成功したときだけ状態を更新
+// 2026/10/17   ばんと      ST7032i_queue_run() を割り込みとメインループから同時に呼ばれても重ならないようにした
 //=============================================================================
 
 /* Includes ------------------------------------------------------------------*/
 #include <stdbool.h>
+#include <stddef.h>
+#ifdef __AVR__
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <avr/pgmspace.h>
-#include "delay.h"
-#include "ST7032i.h"
+#endif
 #include "TinyI2CMaster.h"
+#include "TinyWait.h"
+#include "ST7032i.h"
 
 /* local typedef -------------------------------------------------------------*/
 //アイコンのアドレスとビットの関係
@@ -31,14 +51,73 @@ typedef struct{
 #endif
 
 /* local define --------------------------------------------------------------*/
+// 制御バイト Co=1 なら次の1バイトの後にまた制御バイトが来る
+#define ST7032I_CTRL_CMD_MORE	0x80		// Co=1 RS=0 コマンド1バイト
+#define ST7032I_CTRL_DATA_MORE	0xC0		// Co=1 RS=1 データ1バイト
+#define ST7032I_CTRL_CO			0x80		// Co ビット
+#define ST7032I_CTRL_DATA		0x40		// Co=0 RS=1 以降はすべて表示データ
+// START+アドレス+制御バイトのバス時間(us) 次の命令が届くまでに最低これだけ経つ
+#define ST7032I_PREFIX_US		((18UL * (T2_TWI_NS + T4_TWI_NS)) / 1000UL)
 /* local macro ---------------------------------------------------------------*/
+// 命令の実行時間(us)
+#define ST7032I_EXEC_TIME(cmd)	(((cmd) == LCD_CLEARDISPLAY || ((cmd) & 0xFE) == LCD_RETURNHOME) ? ST7032I_EXEC_LONG_US : ST7032I_EXEC_US)
+#ifdef USE_ST7032I_FRAMEBUFFER
+#define FB_SIZE				(ST7032I_FB_ROWS * ST7032I_FB_COLS)
+#define FB_IS_DIRTY(i)		(lcd_dirty[(i) >> 3] & _BV((i) & 7))
+#endif
+#ifdef USE_ST7032I_QUEUE
+// 割り込み禁止区間(ホストでは割り込みがないので何もしない)
+#ifdef __AVR__
+#define LCD_ATOMIC_BEGIN(sreg)	do { (sreg) = SREG; cli(); } while (0)
+#define LCD_ATOMIC_END(sreg)	(SREG = (sreg))
+#else
+#define LCD_ATOMIC_BEGIN(sreg)	((sreg) = 0)
+#define LCD_ATOMIC_END(sreg)	((void)(sreg))
+#endif
+#endif
 /* local variables -----------------------------------------------------------*/
+static TINYI2C_BUS *lcd_bus = TINYI2C_DEFAULT_BUS;	// 接続先のバス
+static uint16_t lcd_ready;							// 最後の命令の実行時間(us) ST7032I_CLOCK_US があれば完了時刻
+static uint8_t lcd_pending;							// lcd_ready をまだ待ち終えていない
 uint8_t _display_basic;
 uint8_t _display_extended;
 uint8_t _displaymode;
 uint8_t _displaycontrol;
 uint8_t _rab;
 
+#ifdef USE_ST7032I_FRAMEBUFFER
+static uint8_t lcd_fb[FB_SIZE];						// 表示したい内容(行ごとに ST7032I_FB_COLS 文字)
+static uint8_t lcd_dirty[(FB_SIZE + 7) / 8];		// LCDに送っていない文字のビット
+#endif
+
+#ifdef USE_ST7032I_QUEUE
+// 呼び出し側が tail、ST7032i_queue_run() 側が head だけを書き換える
+static uint8_t lcd_q_mode[ST7032I_QUEUE_SIZE];		// 0x00=命令 0x40=データ
+static uint8_t lcd_q_data[ST7032I_QUEUE_SIZE];
+static volatile uint8_t lcd_q_head;					// 次に送る段
+static volatile uint8_t lcd_q_tail;					// 次に積む段
+static uint8_t lcd_q_tx[ST7032I_QUEUE_TX];			// 送信中の転送
+static volatile uint8_t lcd_q_running;				// ST7032i_queue_run() の実行中(割り込みから重ねて呼ばれたら何もしない)
+#ifdef USE_ASYNC_TRANSFER
+static TINYI2C_JOB lcd_q_job;
+static volatile uint8_t lcd_q_taken;				// 送信中の段数 0なら送信していない
+static volatile uint8_t lcd_q_status;				// 失敗した転送の結果(次の ST7032i_queue_run() で返す)
+static uint16_t lcd_q_exec;							// 送信中の最後の命令の実行時間
+#endif
+#endif
+
+#ifdef USE_ST7032I_GLYPH_CACHE
+// 枠ごとの文字の形(8行×5ビットを詰めたもの)と使った順
+static uint8_t lcd_glyph_key[ST7032I_CGRAM_SLOTS][5];
+static uint8_t lcd_glyph_rank[ST7032I_CGRAM_SLOTS];	// 0=最近使った ST7032I_CGRAM_SLOTS-1=一番古い
+static uint8_t lcd_glyph_valid;						// 形が入っている枠のビット
+#endif
+
+#ifdef USE_POLLED_TRANSFER
+static TINYI2C_JOB lcd_job;
+static uint8_t lcd_poll_buf[3 + ST7032I_POLL_COLS];	// 制御+アドレス+制御+文字
+#endif
+
 #ifdef STRAWBERRY_LINUX_16x2_LCD
 const uint8_t Icon_Table[9][2] = {
 	{0x00, 0b10000},
@@ -54,31 +133,287 @@ const uint8_t Icon_Table[9][2] = {
 #endif
 
 /* local function prototypes -------------------------------------------------*/
+static uint8_t ST7032i_wait_ready( void );
+static void ST7032i_wait_exec( void );
+static uint16_t ST7032i_exec_left( void );
+static void ST7032i_issued( uint16_t exec_us );
+static uint8_t ST7032i_batch_closed( const ST7032I_BATCH *batch );
+static uint8_t ST7032i_setControl( uint8_t control );
+static uint8_t ST7032i_setMode( uint8_t mode );
+static uint8_t ST7032i_cgram_write( uint8_t location, const uint8_t *charmap );
+#ifdef USE_ST7032I_GLYPH_CACHE
+static void ST7032i_glyph_pack( const uint8_t *charmap, uint8_t *key );
+static void ST7032i_glyph_touch( uint8_t slot );
+#endif
+#ifdef USE_ST7032I_QUEUE
+static uint8_t ST7032i_queue_send( void );
+static uint8_t ST7032i_queue_put( uint8_t data, uint8_t mode );
+static uint8_t ST7032i_queue_build( uint8_t *taken, uint16_t *exec_us );
+static void ST7032i_queue_drop( uint8_t taken );
+#ifdef USE_ASYNC_TRANSFER
+static void ST7032i_queue_done( TINYI2C_JOB *job );
+#endif
+#endif
+#ifdef USE_ST7032I_FRAMEBUFFER
+static void ST7032i_fb_fill( uint8_t dirty );
+static void ST7032i_fb_mark( uint8_t index, uint8_t len, uint8_t dirty );
+static uint8_t ST7032i_fb_send( TINYI2C_MSG *msgs, uint8_t runs );
+#endif
+
+/*======================================*/
+/*  ST7032i 接続するバスの指定			*/
+/*  指定しなければ TinyI2C_bus0			*/
+/*======================================*/
+void ST7032i_setBus( TINYI2C_BUS *bus )
+{
+	lcd_bus = bus;
+}
 
 /*======================================*/
 /*  ST7032i 書き込み関数				*/
+/*  リトライはバスのリトライ方針に従う	*/
+/*  USE_ST7032I_QUEUE のときはキューに	*/
+/*  積むだけ(満杯ならTINYI2C_QUEUE_FULL)	*/
 /*======================================*/
 uint8_t ST7032i_Write( uint8_t data, uint8_t mode )
 {
-	uint8_t buf[2], i;
-	uint8_t rc;		// リトライカウント
+#ifdef USE_ST7032I_QUEUE
+	return ST7032i_queue_put(data, mode);
+#else
+	uint8_t buf[2];
+	uint8_t status;
 
-	rc = 1;							// Retry out
-    for(i = 0; i < RETRY_ST7032I; i++)
-    {
-		buf[0] = mode;				// モード
-		buf[1] = data;				// データ
-		if ((rc = TinyI2C_write_data(ST7032I_ADDR, buf, sizeof(buf), SEND_STOP)) != 0)
-		{
-			continue;
-		}
-		else
+	buf[0] = mode;				// モード
+	buf[1] = data;				// データ
+
+	status = ST7032i_wait_ready();
+	if (status != TINYI2C_NO_ERROR)
+	{
+		return status;
+	}
+	status = TinyI2C_write_data(lcd_bus, ST7032I_ADDR, buf, sizeof(buf), SEND_STOP);
+	ST7032i_issued((mode & ST7032I_CTRL_DATA) ? ST7032I_EXEC_US : ST7032I_EXEC_TIME(data));
+
+	return status;
+#endif
+}
+
+/*======================================*/
+/*  直接送る前の準備					*/
+/*  キューに積んだものを先に送り切り、	*/
+/*  前の命令の実行が終わるまで待つ		*/
+/*  戻値: キューの送信に失敗したらその	*/
+/*  結果(LCDが応答しないなど 送らない)	*/
+/*======================================*/
+static uint8_t ST7032i_wait_ready( void )
+{
+	uint8_t status;
+
+	status = TINYI2C_NO_ERROR;
+#ifdef USE_ST7032I_QUEUE
+	do
+	{
+		status = ST7032i_queue_run();
+	}
+	while (status == TINYI2C_BUSY);
+	if (status != TINYI2C_NO_ERROR)
+	{
+		return status;
+	}
+#endif
+	ST7032i_wait_exec();
+
+	return status;
+}
+
+/*======================================*/
+/*  前の命令の実行が終わるまで待つ		*/
+/*  送信を始めてから命令が届くまでの	*/
+/*  バス時間を差し引き、足りない分だけ	*/
+/*======================================*/
+static void ST7032i_wait_exec( void )
+{
+	uint16_t left;
+
+	left = ST7032i_exec_left();
+	if (left > 0)
+	{
+		TinyWait_us(left);
+		lcd_pending = 0;
+	}
+}
+
+/*======================================*/
+/*  次の送信を始めるまでに待つ時間(us)	*/
+/*  完了時刻を過ぎたら待ちを忘れるので	*/
+/*  時計が1周しても比べ直さない			*/
+/*  記録する実行時間より先の完了時刻は	*/
+/*  とうに過ぎたもの(長く間が空いた)	*/
+/*======================================*/
+static uint16_t ST7032i_exec_left( void )
+{
+	uint16_t left;
+
+	if (!lcd_pending)
+	{
+		return 0;
+	}
+#ifdef ST7032I_CLOCK_US
+	left = lcd_ready - (uint16_t)ST7032I_CLOCK_US();
+	if (left > ST7032I_EXEC_LONG_US + ST7032I_EXEC_US)
+	{
+		left = 0;
+	}
+#else
+	left = lcd_ready;
+#endif
+	if (left <= ST7032I_PREFIX_US)
+	{
+		lcd_pending = 0;
+		return 0;
+	}
+
+	return left - ST7032I_PREFIX_US;
+}
+
+/*======================================*/
+/*  送信した最後の命令の実行時間を記録	*/
+/*======================================*/
+static void ST7032i_issued( uint16_t exec_us )
+{
+#ifdef ST7032I_CLOCK_US
+	lcd_ready = (uint16_t)ST7032I_CLOCK_US() + exec_us;
+#else
+	lcd_ready = exec_us;
+#endif
+	lcd_pending = 1;
+}
+
+/*======================================*/
+/*  命令バッチの初期化					*/
+/*======================================*/
+void ST7032i_batch_init( ST7032I_BATCH *batch )
+{
+	batch->n = 0;
+}
+
+/*======================================*/
+/*  命令バッチが長い命令で終わっている	*/
+/*  実行中の1.08msは次を受け付けないので*/
+/*  その後には何もつなげない			*/
+/*======================================*/
+static uint8_t ST7032i_batch_closed( const ST7032I_BATCH *batch )
+{
+	return batch->n != 0 && !(batch->buf[2 * batch->n - 2] & ST7032I_CTRL_DATA) &&
+		ST7032I_EXEC_TIME(batch->buf[2 * batch->n - 1]) != ST7032I_EXEC_US;
+}
+
+/*======================================*/
+/*  命令バッチに命令を追加				*/
+/*  戻値: TINYI2C_QUEUE_FULL=満杯		*/
+/*  TINYI2C_BAD_MSG=長い命令の後		*/
+/*======================================*/
+uint8_t ST7032i_batch_cmd( ST7032I_BATCH *batch, uint8_t cmd )
+{
+	if (ST7032i_batch_closed(batch))
+	{
+		return TINYI2C_BAD_MSG;
+	}
+	if (batch->n >= ST7032I_BATCH_MAX)
+	{
+		return TINYI2C_QUEUE_FULL;
+	}
+
+	batch->buf[2 * batch->n] = ST7032I_CTRL_CMD_MORE;
+	batch->buf[2 * batch->n + 1] = cmd;
+	batch->n++;
+
+	return TINYI2C_NO_ERROR;
+}
+
+/*======================================*/
+/*  命令バッチにデータ(RS=1)を追加		*/
+/*  戻値: TINYI2C_QUEUE_FULL=満杯		*/
+/*  TINYI2C_BAD_MSG=長い命令の後		*/
+/*======================================*/
+uint8_t ST7032i_batch_data( ST7032I_BATCH *batch, uint8_t data )
+{
+	if (ST7032i_batch_closed(batch))
+	{
+		return TINYI2C_BAD_MSG;
+	}
+	if (batch->n >= ST7032I_BATCH_MAX)
+	{
+		return TINYI2C_QUEUE_FULL;
+	}
+
+	batch->buf[2 * batch->n] = ST7032I_CTRL_DATA_MORE;
+	batch->buf[2 * batch->n + 1] = data;
+	batch->n++;
+
+	return TINYI2C_NO_ERROR;
+}
+
+/*======================================*/
+/*  命令バッチを1回の転送で送る			*/
+/*  最後の制御バイトだけCo=0にする		*/
+/*  命令の間隔は2バイト分のバス時間		*/
+/*  (400kHzでも実行時間26.3usより長い)	*/
+/*  最後の命令の実行時間は次の送信前に	*/
+/*  必要なら待つ						*/
+/*======================================*/
+uint8_t ST7032i_batch_commit( ST7032I_BATCH *batch )
+{
+	uint8_t status;
+
+	if (batch->n == 0)
+	{
+		return TINYI2C_NO_ERROR;
+	}
+
+	status = ST7032i_wait_ready();
+	if (status != TINYI2C_NO_ERROR)
+	{
+		return status;
+	}
+	batch->buf[2 * batch->n - 2] &= ~ST7032I_CTRL_CO;
+	status = TinyI2C_write_data(lcd_bus, ST7032I_ADDR, batch->buf, 2 * batch->n, SEND_STOP);
+	ST7032i_issued((batch->buf[2 * batch->n - 2] & ST7032I_CTRL_DATA) ? ST7032I_EXEC_US : ST7032I_EXEC_TIME(batch->buf[2 * batch->n - 1]));
+	batch->n = 0;
+
+	return status;
+}
+
+/*======================================*/
+/*  命令の並びを1回の転送で送る			*/
+/*  途中の長い命令の後では転送を分け、	*/
+/*  実行が終わってから続きを送る		*/
+/*======================================*/
+uint8_t ST7032i_WriteCmds( const uint8_t *cmds, uint8_t n )
+{
+	ST7032I_BATCH batch;
+	uint8_t status;
+
+	ST7032i_batch_init(&batch);
+	for (status = TINYI2C_NO_ERROR; n > 0 && status == TINYI2C_NO_ERROR; n--)
+	{
+		status = ST7032i_batch_cmd(&batch, *cmds);
+		if (status == TINYI2C_BAD_MSG)
 		{
-			break;
+			status = ST7032i_batch_commit(&batch);
+			if (status == TINYI2C_NO_ERROR)
+			{
+				status = ST7032i_batch_cmd(&batch, *cmds);
+			}
 		}
+		cmds++;
+	}
+	if (status != TINYI2C_NO_ERROR)
+	{
+		return status;
 	}
 
-	return rc;
+	return ST7032i_batch_commit(&batch);
 }
 
 /*======================================*/
@@ -90,7 +425,7 @@ void ST7032i_InitPort( void )
 	ST7032i_WAKE_UP_DDR = _BV(ST7032i_WAKE_UP_DDR_NO);		//
 	ST7032i_WAKE_UP_PORT &= ~_BV(ST7032i_WAKE_UP_PORT_NO);	// 
 
-	wait_ms(1);
+	TinyWait_ms(1);
 }
 #endif
 
@@ -101,10 +436,10 @@ void ST7032i_InitPort( void )
 void ST7032i_WakeUp( void )
 {
 	ST7032i_WAKE_UP_PORT &= ~_BV(ST7032i_WAKE_UP_PORT_NO);
-	wait_ms(1);
+	TinyWait_ms(1);
 
 	ST7032i_WAKE_UP_PORT |= _BV(ST7032i_WAKE_UP_PORT_NO);
-	wait_ms(10);
+	TinyWait_ms(10);
 }
 #endif
 
@@ -114,6 +449,7 @@ void ST7032i_WakeUp( void )
 void ST7032i_Init( void )
 {
 	uint8_t contrast = 45;
+	ST7032I_BATCH batch;
 
 	_display_basic = LCD_INSTRUCTION_SET_BASIC | LCD_8BITMODE | LCD_1LINE | LCD_5x8DOTS;
 	_display_extended = LCD_INSTRUCTION_SET_EXTENDED | LCD_8BITMODE | LCD_1LINE | LCD_5x8DOTS;
@@ -128,69 +464,75 @@ void ST7032i_Init( void )
 #ifdef USE_ST7032I_WAKEUP
 	ST7032i_WakeUp( );
 #endif
-    wait_ms(40);
+    TinyWait_ms(ST7032I_POWERON_MS);
 
+    // 電源が安定するまでの命令を1回で送る
+    ST7032i_batch_init(&batch);
     // function set  basic
-    ST7032i_WriteCmd(LCD_FUNCTIONSET | _display_basic );
-    wait_ms(30);
-
+    ST7032i_batch_cmd(&batch, LCD_FUNCTIONSET | _display_basic );
     // function set extended
-    ST7032i_WriteCmd(LCD_FUNCTIONSET | _display_extended);
-    wait_ms(30);
-
+    ST7032i_batch_cmd(&batch, LCD_FUNCTIONSET | _display_extended);
     // interval osc
-    ST7032i_WriteCmd(LCD_BIAS_OSC_CONTROL | LCD_BIAS1_5 | LCD_OSC_192);
-    wait_ms(30);
-
+    ST7032i_batch_cmd(&batch, LCD_BIAS_OSC_CONTROL | LCD_BIAS1_5 | LCD_OSC_192);
     // contrast low nible
-    ST7032i_WriteCmd(LCD_CONTRAST_LOW_BYTE | (contrast & LCD_CONTRAST_LOW_BYTE_MASK));
-    wait_ms(30);
-
+    ST7032i_batch_cmd(&batch, LCD_CONTRAST_LOW_BYTE | (contrast & LCD_CONTRAST_LOW_BYTE_MASK));
     // contrast high nible / icon / power
-    ST7032i_WriteCmd(LCD_ICON_CONTRAST_HIGH_BYTE | LCD_ICON_ON | LCD_BOOSTER_ON | (contrast >> 4 & LCD_CONTRAST_HIGH_BYTE_MASK));
-    wait_ms(30);
-
+    ST7032i_batch_cmd(&batch, LCD_ICON_CONTRAST_HIGH_BYTE | LCD_ICON_ON | LCD_BOOSTER_ON | (contrast >> 4 & LCD_CONTRAST_HIGH_BYTE_MASK));
     // follower control
     _rab = LCD_Rab_2_00;
-    ST7032i_WriteCmd(LCD_FOLLOWER_CONTROL | LCD_FOLLOWER_ON | _rab);
-    wait_ms(200);
+    ST7032i_batch_cmd(&batch, LCD_FOLLOWER_CONTROL | LCD_FOLLOWER_ON | _rab);
+    ST7032i_batch_commit(&batch);
+    TinyWait_ms(ST7032I_FOLLOWER_MS);
 
+    // 残りも1回で送る
     // function set basic
-    ST7032i_WriteCmd(LCD_FUNCTIONSET | _display_basic);
-    wait_ms(30);
-
+    ST7032i_batch_cmd(&batch, LCD_FUNCTIONSET | _display_basic);
     // display on
-    ST7032i_WriteCmd(LCD_DISPLAYCONTROL |  LCD_DISPLAYON |  LCD_CURSOROFF | LCD_BLINKOFF );
-    wait_ms(30);
-
+    ST7032i_batch_cmd(&batch, LCD_DISPLAYCONTROL |  LCD_DISPLAYON |  LCD_CURSOROFF | LCD_BLINKOFF );
     // entry mode set
     _displaymode=LCD_ENTRYLEFT | LCD_ENTRYSHIFTDECREMENT;
-    ST7032i_WriteCmd(LCD_ENTRYMODESET | _displaymode);
-    wait_ms(30);
+    ST7032i_batch_cmd(&batch, LCD_ENTRYMODESET | _displaymode);
+    ST7032i_batch_commit(&batch);
+
+#ifdef USE_ST7032I_FRAMEBUFFER
+    ST7032i_fb_fill(1);			// DDRAMの中身は分からないので次の flush で全部送る
+#endif
+#ifdef USE_ST7032I_GLYPH_CACHE
+    ST7032i_glyph_reset();		// CGRAMの中身も分からない
+#endif
 }
 
 /*======================================*/
 /*  ST7032i 画面消去関数                */
+/*  戻値: 0=送信(積んだ) それ以外失敗	*/
 /*======================================*/
-void ST7032i_Clear( void )
+uint8_t ST7032i_Clear( void )
 {
-    ST7032i_WriteCmd(LCD_CLEARDISPLAY);
-    wait_ms(2);
+    uint8_t status;
+
+    status = ST7032i_WriteCmd(LCD_CLEARDISPLAY);
+#ifdef USE_ST7032I_FRAMEBUFFER
+    if (status == TINYI2C_NO_ERROR)
+    {
+        ST7032i_fb_fill(0);		// LCDも空白になった
+    }
+#endif
+
+    return status;
 }
 
 /*======================================*/
 /*  ST7032i ホームポジション関数		*/
 /*======================================*/
-void ST7032i_Home( void )
+uint8_t ST7032i_Home( void )
 {
-    ST7032i_WriteCmd(LCD_RETURNHOME);  // set cursor position to zero
-    wait_ms(2);  // this command takes a long time!
+    return ST7032i_WriteCmd(LCD_RETURNHOME);  // set cursor position to zero (1.08ms 次の命令の前に待つ)
 }
 
 /*======================================*/
 /*  ST7032i カーソル表示関数			*/
 /*======================================*/
-void ST7032i_setCursor(uint8_t col, uint8_t row)
+uint8_t ST7032i_setCursor(uint8_t col, uint8_t row)
 {
     int row_offsets[] = { 0x00, 0x40, 0x14, 0x54 };
 
@@ -198,157 +540,320 @@ void ST7032i_setCursor(uint8_t col, uint8_t row)
     {
         row = ST7032_NUM_LINES - 1;    // we count rows starting w/0
     }
-    ST7032i_WriteCmd(LCD_SETDDRAMADDR | (col + row_offsets[row]));
-    wait_ms(30);
+    return ST7032i_WriteCmd(LCD_SETDDRAMADDR | (col + row_offsets[row]));
+}
+
+/*======================================*/
+/*  表示制御命令を送り、送れたら覚える	*/
+/*======================================*/
+static uint8_t ST7032i_setControl( uint8_t control )
+{
+    uint8_t status;
+
+    status = ST7032i_WriteCmd(LCD_DISPLAYCONTROL | control);
+    if (status == TINYI2C_NO_ERROR)
+    {
+        _displaycontrol = control;
+    }
+
+    return status;
+}
+
+/*======================================*/
+/*  エントリモード命令を送り、送れたら	*/
+/*  覚える								*/
+/*======================================*/
+static uint8_t ST7032i_setMode( uint8_t mode )
+{
+    uint8_t status;
+
+    status = ST7032i_WriteCmd(LCD_ENTRYMODESET | mode);
+    if (status == TINYI2C_NO_ERROR)
+    {
+        _displaymode = mode;
+    }
+
+    return status;
 }
 
 /*======================================*/
 /*  ST7032i 表示オン関数		        */
 /*======================================*/
-void ST7032i_onDisplay( void )
+uint8_t ST7032i_onDisplay( void )
 {
-    _displaycontrol |= LCD_DISPLAYON;
-    ST7032i_WriteCmd(LCD_DISPLAYCONTROL | _displaycontrol);
-    wait_ms(30);
+    return ST7032i_setControl(_displaycontrol | LCD_DISPLAYON);
 }
 
 /*======================================*/
 /*  ST7032i 表示オフ関数		        */
 /*======================================*/
-void ST7032i_offDisplay( void )
+uint8_t ST7032i_offDisplay( void )
 {
-    _displaycontrol &= ~LCD_DISPLAYON;
-    ST7032i_WriteCmd(LCD_DISPLAYCONTROL | _displaycontrol);
-    wait_ms(30);
+    return ST7032i_setControl(_displaycontrol & ~LCD_DISPLAYON);
 }
 
 /*======================================*/
 /*  ST7032i カーソルオン関数	        */
 /*======================================*/
-void ST7032i_onCursor( void )
+uint8_t ST7032i_onCursor( void )
 {
-    _displaycontrol |= LCD_CURSORON;
-    ST7032i_WriteCmd(LCD_DISPLAYCONTROL | _displaycontrol);
-    wait_ms(30);
+    return ST7032i_setControl(_displaycontrol | LCD_CURSORON);
 }
 
 /*======================================*/
 /*  ST7032i カーソルオフ関数	        */
 /*======================================*/
-void ST7032i_offCursor( void )
+uint8_t ST7032i_offCursor( void )
 {
-    _displaycontrol &= ~LCD_CURSORON;
-    ST7032i_WriteCmd(LCD_DISPLAYCONTROL | _displaycontrol);
-    wait_ms(30);
+    return ST7032i_setControl(_displaycontrol & ~LCD_CURSORON);
 }
 
 /*======================================*/
 /*  ST7032i ブリンクオン関数	        */
 /*======================================*/
-void ST7032i_onBlink( void )
+uint8_t ST7032i_onBlink( void )
 {
-    _displaycontrol |= LCD_BLINKON;
-    ST7032i_WriteCmd(LCD_DISPLAYCONTROL | _displaycontrol);
-    wait_ms(30);
+    return ST7032i_setControl(_displaycontrol | LCD_BLINKON);
 }
 
 /*======================================*/
 /*  ST7032i ブリンクオフ関数	        */
 /*======================================*/
-void ST7032i_offBlink( void )
+uint8_t ST7032i_offBlink( void )
 {
-    _displaycontrol &= ~LCD_BLINKON;
-    ST7032i_WriteCmd(LCD_DISPLAYCONTROL | _displaycontrol);
-    wait_ms(30);
+    return ST7032i_setControl(_displaycontrol & ~LCD_BLINKON);
 }
 
 /*======================================*/
 /*  ST7032i 左スクロール関数	        */
 /*======================================*/
 // These commands scroll the display without changing the RAM
-void ST7032i_scrollDisplayLeft( void )
+uint8_t ST7032i_scrollDisplayLeft( void )
 {
-    ST7032i_WriteCmd(LCD_FUNCTIONSET | _display_basic);
-    wait_ms(30);
+    uint8_t status;
 
-    ST7032i_WriteCmd(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVELEFT);
-    wait_ms(30);
+    status = ST7032i_WriteCmd(LCD_FUNCTIONSET | _display_basic);
+    if (status != TINYI2C_NO_ERROR)
+    {
+        return status;
+    }
+
+    return ST7032i_WriteCmd(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVELEFT);
 }
 
 /*======================================*/
 /*  ST7032i 右スクロール関数	        */
 /*======================================*/
-void ST7032i_scrollDisplayRight( void )
+uint8_t ST7032i_scrollDisplayRight( void )
 {
-    ST7032i_WriteCmd(LCD_FUNCTIONSET | _display_basic);
-    wait_ms(30);
+    uint8_t status;
 
-    ST7032i_WriteCmd(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVERIGHT);
-    wait_ms(30);
+    status = ST7032i_WriteCmd(LCD_FUNCTIONSET | _display_basic);
+    if (status != TINYI2C_NO_ERROR)
+    {
+        return status;
+    }
+
+    return ST7032i_WriteCmd(LCD_CURSORSHIFT | LCD_DISPLAYMOVE | LCD_MOVERIGHT);
 }
 
 /*======================================*/
 /*  ST7032i 左→右・文字あふれ関数		*/
 /*======================================*/
 // This is for text that flows Left to Right
-void ST7032i_leftToRight( void )
+uint8_t ST7032i_leftToRight( void )
 {
-    _displaymode |= LCD_ENTRYLEFT;
-    ST7032i_WriteCmd(LCD_ENTRYMODESET | _displaymode);
-    wait_ms(30);
+    return ST7032i_setMode(_displaymode | LCD_ENTRYLEFT);
 }
 
 /*======================================*/
 /*  ST7032i 右→左・文字あふれ関数		*/
 /*======================================*/
 // This is for text that flows Right to Left
-void ST7032i_rightToLeft( void )
+uint8_t ST7032i_rightToLeft( void )
 {
-    _displaymode &= ~LCD_ENTRYLEFT;
-    ST7032i_WriteCmd(LCD_ENTRYMODESET | _displaymode);
-    wait_ms(30);
+    return ST7032i_setMode(_displaymode & ~LCD_ENTRYLEFT);
 }
 
 /*======================================*/
 /*  ST7032i オートスクロール・オン関数	*/
 /*======================================*/
 // This will 'right justify' text from the cursor
-void ST7032i_onAutoscroll( void )
+uint8_t ST7032i_onAutoscroll( void )
 {
-    _displaymode |= LCD_ENTRYSHIFTINCREMENT;
-    ST7032i_WriteCmd(LCD_ENTRYMODESET | _displaymode);
-    wait_ms(30);
+    return ST7032i_setMode(_displaymode | LCD_ENTRYSHIFTINCREMENT);
 }
 
 /*======================================*/
 /*  ST7032i オートスクロール・オフ関数	*/
 /*======================================*/
 // This will 'left justify' text from the cursor
-void ST7032i_offAutoscroll( void )
+uint8_t ST7032i_offAutoscroll( void )
 {
-    _displaymode &= ~LCD_ENTRYSHIFTINCREMENT;
-    ST7032i_WriteCmd(LCD_ENTRYMODESET | _displaymode);
-    wait_ms(30);
+    return ST7032i_setMode(_displaymode & ~LCD_ENTRYSHIFTINCREMENT);
 }
 
 /*======================================*/
 /*  ST7032i ユーザ文字作成関数			*/
 /*======================================*/
 // Allows us to fill the first 8 CGRAM locations with custom characters
+// アドレスカウンタはCGRAMを指したままになるので、次の文字の前に setCursor すること
 void ST7032i_createChar(uint8_t location, uint8_t charmap[])
 {
-    int i;
-
     location &= 0x7; // we only have 8 locations 0-7
-    ST7032i_WriteCmd(LCD_SETCGRAMADDR | (location << 3));
-    wait_ms(30);
+    ST7032i_cgram_write(location, charmap);
+#ifdef USE_ST7032I_GLYPH_CACHE
+    lcd_glyph_valid &= ~_BV(location);		// キャッシュの知らない形になった
+#endif
+}
+
+/*======================================*/
+/*  CGRAMの1枠(8行)を1回の転送で書く	*/
+/*  [0x80, CGRAMアドレス, 0x40, 8行]	*/
+/*======================================*/
+static uint8_t ST7032i_cgram_write( uint8_t location, const uint8_t *charmap )
+{
+    uint8_t buf[3 + 8];
+    uint8_t i;
+    uint8_t status;
+
+    buf[0] = ST7032I_CTRL_CMD_MORE;
+    buf[1] = LCD_SETCGRAMADDR | (location << 3);
+    buf[2] = ST7032I_CTRL_DATA;
+    for (i = 0; i < 8; i++)
+    {
+        buf[3 + i] = charmap[i];
+    }
+
+    status = ST7032i_wait_ready();
+    if (status != TINYI2C_NO_ERROR)
+    {
+        return status;
+    }
+    status = TinyI2C_write_data(lcd_bus, ST7032I_ADDR, buf, sizeof(buf), SEND_STOP);
+    ST7032i_issued(ST7032I_EXEC_US);
+
+    return status;
+}
+
+#ifdef USE_ST7032I_GLYPH_CACHE
+/*======================================*/
+/*  ユーザ文字の文字コードを得る		*/
+/*  同じ形がCGRAMにあればそのまま、		*/
+/*  なければ空き枠か一番古く使った枠に	*/
+/*  書き込む(形で見分けるので配列の		*/
+/*  中身を書き換えて呼んでもよい)		*/
+/*  追い出した枠の文字を表示していれば	*/
+/*  その表示も変わるので、同時に表示	*/
+/*  するのは8種類まで					*/
+/*  書き込んだときはアドレスカウンタが	*/
+/*  CGRAMを指すので、次の文字の前に		*/
+/*  setCursor すること(フレームバッファ	*/
+/*  の flush は区間ごとに指定するので	*/
+/*  そのままでよい)						*/
+/*  戻値: 文字コード(0-7) 0xFF=通信失敗	*/
+/*======================================*/
+uint8_t ST7032i_glyph(const uint8_t *charmap)
+{
+    uint8_t key[5];
+    uint8_t slot, i;
+
+    ST7032i_glyph_pack(charmap, key);
+
+    // 同じ形の枠を探す(なければ空き枠か一番古い枠)
+    slot = 0;
+    for (i = 0; i < ST7032I_CGRAM_SLOTS; i++)
+    {
+        if (lcd_glyph_valid & _BV(i))
+        {
+            if (lcd_glyph_key[i][0] == key[0] && lcd_glyph_key[i][1] == key[1] &&
+                lcd_glyph_key[i][2] == key[2] && lcd_glyph_key[i][3] == key[3] && lcd_glyph_key[i][4] == key[4])
+            {
+                ST7032i_glyph_touch(i);
+                return i;
+            }
+            if ((lcd_glyph_valid & _BV(slot)) && lcd_glyph_rank[i] > lcd_glyph_rank[slot])
+            {
+                slot = i;
+            }
+        }
+        else if (lcd_glyph_valid & _BV(slot))
+        {
+            slot = i;
+        }
+    }
+
+    lcd_glyph_valid &= ~_BV(slot);
+    if (ST7032i_cgram_write(slot, charmap) != TINYI2C_NO_ERROR)
+    {
+        return 0xFF;
+    }
+    for (i = 0; i < 5; i++)
+    {
+        lcd_glyph_key[slot][i] = key[i];
+    }
+    lcd_glyph_valid |= _BV(slot);
+    ST7032i_glyph_touch(slot);
+
+    return slot;
+}
+
+/*======================================*/
+/*  キャッシュを空にする				*/
+/*  (CGRAMの中身が分からなくなったとき)	*/
+/*======================================*/
+void ST7032i_glyph_reset( void )
+{
+    uint8_t i;
+
+    lcd_glyph_valid = 0;
+    for (i = 0; i < ST7032I_CGRAM_SLOTS; i++)
+    {
+        lcd_glyph_rank[i] = i;
+    }
+}
+
+/*======================================*/
+/*  8行×5ビットを5バイトに詰める		*/
+/*  (表示されない上位3ビットは無視)		*/
+/*======================================*/
+static void ST7032i_glyph_pack( const uint8_t *charmap, uint8_t *key )
+{
+    uint8_t i, bit;
+    uint8_t row;
+
+    for (i = 0; i < 5; i++)
+    {
+        key[i] = 0;
+    }
+    for (i = 0, bit = 0; i < 8; i++, bit += 5)
+    {
+        row = charmap[i] & 0x1F;
+        key[bit >> 3] |= row << (bit & 7);
+        if ((bit & 7) > 3)
+        {
+            key[(bit >> 3) + 1] |= row >> (8 - (bit & 7));
+        }
+    }
+}
 
-    for (i=0; i<8; i++)
+/*======================================*/
+/*  枠を最近使ったことにする			*/
+/*======================================*/
+static void ST7032i_glyph_touch( uint8_t slot )
+{
+    uint8_t i;
+
+    for (i = 0; i < ST7032I_CGRAM_SLOTS; i++)
     {
-        ST7032i_WriteData(charmap[i]);
-        wait_ms(30);
+        if (lcd_glyph_rank[i] < lcd_glyph_rank[slot])
+        {
+            lcd_glyph_rank[i]++;
+        }
     }
+    lcd_glyph_rank[slot] = 0;
 }
+#endif
 
 /*======================================*/
 /*  ST7032i コントラスト設定関数		*/
@@ -358,46 +863,571 @@ void ST7032i_createChar(uint8_t location, uint8_t charmap[])
 // In case of the YMFC-G0802D the follower value is 0x04. According to the info in the ST7032 datasheet this gives us a range of 0 to 10 for the contrast.
 // The setting in this library are desigend for and tesed on display YMFC-G0802D ( sold on eBay zyscom http://stores.ebay.com/zyscom?_trksid=p4340.l2563 )
 // For other displays other values and ranges may apply.
+// 拡張命令セットに切り換えて設定し、基本命令セットに戻すまでを1回で送る
 void ST7032i_setContrast(uint8_t new_val)
 {
-    ST7032i_WriteCmd(LCD_FUNCTIONSET | _display_extended);
-    wait_ms(30);	//																								Needed ??
+    uint8_t cmds[4];
 
-    ST7032i_WriteCmd(LCD_ICON_CONTRAST_HIGH_BYTE | LCD_ICON_ON | LCD_BOOSTER_ON | (new_val >> 4 & LCD_CONTRAST_HIGH_BYTE_MASK));
-    wait_ms(30);
-
-    ST7032i_WriteCmd(LCD_CONTRAST_LOW_BYTE | (new_val & LCD_CONTRAST_LOW_BYTE_MASK));
-    wait_ms(30);
+    cmds[0] = LCD_FUNCTIONSET | _display_extended;
+    cmds[1] = LCD_ICON_CONTRAST_HIGH_BYTE | LCD_ICON_ON | LCD_BOOSTER_ON | (new_val >> 4 & LCD_CONTRAST_HIGH_BYTE_MASK);
+    cmds[2] = LCD_CONTRAST_LOW_BYTE | (new_val & LCD_CONTRAST_LOW_BYTE_MASK);
+    cmds[3] = LCD_FUNCTIONSET | _display_basic;
+    ST7032i_WriteCmds(cmds, sizeof(cmds));
 }
 
 /*======================================*/
 /*  文字例出力関数                      */
+/*  USE_ST7032I_QUEUE のときは全部積める*/
+/*  ときだけ積む(入らなければ何もせず	*/
+/*  TINYI2C_QUEUE_FULL)					*/
 /*======================================*/
-void ST7032i_puts(const char *s)
+uint8_t ST7032i_puts(const char *s)
 {
     register char c;
+    uint8_t status;
+    uint8_t result;
+
+#ifdef USE_ST7032I_QUEUE
+    uint8_t len;
+    uint8_t room;
+
+    room = ST7032i_queue_free();
+    for (len = 0; s[len] != '\0'; len++)
+    {
+        if (len >= room)
+        {
+            return TINYI2C_QUEUE_FULL;
+        }
+    }
+#endif
 
+    status = TINYI2C_NO_ERROR;
     while ((c = *s++))
     {
-        ST7032i_WriteData(c);
+        result = ST7032i_WriteData(c);
+        if (result != TINYI2C_NO_ERROR)
+        {
+            status = result;
+        }
     }
+
+    return status;
 }
 
 /*======================================*/
 /*  文字例出力関数2						*/
+/*  フラッシュから直接1回の転送で送る	*/
 /*======================================*/
 void ST7032i_puts_p(const char *progmem_s)
 /* print string from program memory on lcd (no auto linefeed) */
 {
-    register char c;
+    uint8_t len;
+
+    for (len = 0; pgm_read_byte(progmem_s + len); len++)
+        ;
 
-    while ( (c = pgm_read_byte(progmem_s++)) )
+    // 制御バイト(Co=0,RS=1)の後はすべて表示データとして続けて書ける
+    if (ST7032i_wait_ready() != TINYI2C_NO_ERROR)
     {
-        ST7032i_WriteData(c);
+        return;
     }
+    TinyI2C_writeRegs_P(lcd_bus, ST7032I_ADDR, 0x40, TINYI2C_REG8, (const uint8_t *)progmem_s, len);
+    ST7032i_issued(ST7032I_EXEC_US);
 
 }/* lcd_puts_p */
 
+#ifdef USE_ST7032I_FRAMEBUFFER
+/*======================================*/
+/*  フレームバッファに1文字書く			*/
+/*  LCDには ST7032i_flush() で送る		*/
+/*======================================*/
+void ST7032i_fb_putc(uint8_t col, uint8_t row, char c)
+{
+    uint8_t i;
+
+    if (col >= ST7032I_FB_COLS || row >= ST7032I_FB_ROWS)
+    {
+        return;
+    }
+
+    i = row * ST7032I_FB_COLS + col;
+    if (lcd_fb[i] != (uint8_t)c)
+    {
+        lcd_fb[i] = c;
+        ST7032i_fb_mark(i, 1, 1);
+    }
+}
+
+/*======================================*/
+/*  フレームバッファに文字列を書く		*/
+/*  行の終わりで切り捨てる				*/
+/*======================================*/
+void ST7032i_fb_puts(uint8_t col, uint8_t row, const char *s)
+{
+    for (; *s != '\0' && col < ST7032I_FB_COLS; s++, col++)
+    {
+        ST7032i_fb_putc(col, row, *s);
+    }
+}
+
+/*======================================*/
+/*  フレームバッファを空白にする		*/
+/*  ST7032i_Clear() と違い、変わった	*/
+/*  文字だけ flush で消す				*/
+/*======================================*/
+void ST7032i_fb_clear( void )
+{
+    uint8_t row, col;
+
+    for (row = 0; row < ST7032I_FB_ROWS; row++)
+    {
+        for (col = 0; col < ST7032I_FB_COLS; col++)
+        {
+            ST7032i_fb_putc(col, row, ' ');
+        }
+    }
+}
+
+/*======================================*/
+/*  次の flush で全部送り直す			*/
+/*  (putc 等でLCDを直接書き換えたとき)	*/
+/*======================================*/
+void ST7032i_fb_invalidate( void )
+{
+    ST7032i_fb_mark(0, FB_SIZE, 1);
+}
+
+/*======================================*/
+/*  フレームバッファの変更をLCDに送る	*/
+/*  変わった文字の区間ごとに			*/
+/*  [0x80, DDRAMアドレス, 0x40, 文字...]	*/
+/*  をリピートスタートでつなぎ、		*/
+/*  ST7032I_FB_RUNS 区間ごとに1回の		*/
+/*  トランザクションで送る				*/
+/*  失敗した区間は次の flush で再送		*/
+/*======================================*/
+uint8_t ST7032i_flush( void )
+{
+    static const uint8_t row_offsets[] = { 0x00, 0x40 };
+    TINYI2C_MSG msgs[2 * ST7032I_FB_RUNS];
+    uint8_t head[ST7032I_FB_RUNS][3];
+    uint8_t row, col, last, k, i;
+    uint8_t runs;
+    uint8_t status;
+
+    runs = 0;
+    for (row = 0; row < ST7032I_FB_ROWS; row++)
+    {
+        for (col = 0; col < ST7032I_FB_COLS; col = last + 1)
+        {
+            i = row * ST7032I_FB_COLS + col;
+            last = col;
+            if (!FB_IS_DIRTY(i))
+            {
+                continue;
+            }
+
+            // 間の変わっていない文字が ST7032I_FB_GAP 以下なら同じ区間にする
+            for (k = col + 1; k < ST7032I_FB_COLS && k - last <= ST7032I_FB_GAP + 1; k++)
+            {
+                if (FB_IS_DIRTY(row * ST7032I_FB_COLS + k))
+                {
+                    last = k;
+                }
+            }
+
+            head[runs][0] = ST7032I_CTRL_CMD_MORE;
+            head[runs][1] = LCD_SETDDRAMADDR | (row_offsets[row] + col);
+            head[runs][2] = ST7032I_CTRL_DATA;
+            msgs[2 * runs].slave_7bit_addr = ST7032I_ADDR;
+            msgs[2 * runs].flags = TINYI2C_M_WR;
+            msgs[2 * runs].len = 3;
+            msgs[2 * runs].buf = head[runs];
+            msgs[2 * runs + 1].slave_7bit_addr = ST7032I_ADDR;
+            msgs[2 * runs + 1].flags = TINYI2C_M_WR | TINYI2C_M_NOSTART;
+            msgs[2 * runs + 1].len = last - col + 1;
+            msgs[2 * runs + 1].buf = &lcd_fb[i];
+
+            if (++runs == ST7032I_FB_RUNS)
+            {
+                status = ST7032i_fb_send(msgs, runs);
+                if (status != TINYI2C_NO_ERROR)
+                {
+                    return status;
+                }
+                runs = 0;
+            }
+        }
+    }
+
+    return ST7032i_fb_send(msgs, runs);
+}
+
+/*======================================*/
+/*  区間をまとめて送り、送れた文字の	*/
+/*  ダーティビットを落とす				*/
+/*======================================*/
+static uint8_t ST7032i_fb_send( TINYI2C_MSG *msgs, uint8_t runs )
+{
+    uint8_t status;
+    uint8_t n;
+
+    if (runs == 0)
+    {
+        return TINYI2C_NO_ERROR;
+    }
+
+    status = ST7032i_wait_ready();
+    if (status != TINYI2C_NO_ERROR)
+    {
+        return status;
+    }
+    status = TinyI2C_transfer_msgs(lcd_bus, msgs, 2 * runs);
+    ST7032i_issued(ST7032I_EXEC_US);
+    if (status == TINYI2C_NO_ERROR)
+    {
+        for (n = 0; n < runs; n++)
+        {
+            ST7032i_fb_mark(msgs[2 * n + 1].buf - lcd_fb, msgs[2 * n + 1].len, 0);
+        }
+    }
+
+    return status;
+}
+
+/*======================================*/
+/*  フレームバッファ全体を空白にする	*/
+/*  dirty: 非0なら全部を未送信にする	*/
+/*======================================*/
+static void ST7032i_fb_fill( uint8_t dirty )
+{
+    uint8_t i;
+
+    for (i = 0; i < FB_SIZE; i++)
+    {
+        lcd_fb[i] = ' ';
+    }
+    ST7032i_fb_mark(0, FB_SIZE, dirty);
+}
+
+/*======================================*/
+/*  ダーティビットの設定/解除			*/
+/*======================================*/
+static void ST7032i_fb_mark( uint8_t index, uint8_t len, uint8_t dirty )
+{
+    for (; len > 0; len--, index++)
+    {
+        if (dirty)
+        {
+            lcd_dirty[index >> 3] |= _BV(index & 7);
+        }
+        else
+        {
+            lcd_dirty[index >> 3] &= ~_BV(index & 7);
+        }
+    }
+}
+#endif
+
+#ifdef USE_ST7032I_QUEUE
+/*======================================*/
+/*  描画キューの空き段数				*/
+/*======================================*/
+uint8_t ST7032i_queue_free( void )
+{
+    uint8_t used;
+
+    used = lcd_q_tail - lcd_q_head;
+    if (lcd_q_tail < lcd_q_head)
+    {
+        used += ST7032I_QUEUE_SIZE;
+    }
+
+    return ST7032I_QUEUE_SIZE - 1 - used;
+}
+
+/*======================================*/
+/*  描画キューを1転送分送る				*/
+/*  タイマー割り込みやメインループから	*/
+/*  呼ぶ 先頭の命令(Co=1でつなぐ)と		*/
+/*  それに続く文字をまとめて1回で送る	*/
+/*  戻値: 0=キューが空					*/
+/*        TINYI2C_BUSY=まだ残っている		*/
+/*        (非同期転送では完了時に続きを	*/
+/*        送るので、次のティックでよい)	*/
+/*        それ以外I2C通信エラー(残す)		*/
+/*  実行中に割り込みから呼ばれたときは	*/
+/*  何もせずTINYI2C_BUSYを返す			*/
+/*======================================*/
+uint8_t ST7032i_queue_run( void )
+{
+    uint8_t sreg;
+    uint8_t status;
+
+    LCD_ATOMIC_BEGIN(sreg);
+    if (lcd_q_running != 0)
+    {
+        LCD_ATOMIC_END(sreg);
+        return TINYI2C_BUSY;                // 割り込まれた側が送っている
+    }
+    lcd_q_running = 1;
+    LCD_ATOMIC_END(sreg);
+
+    status = ST7032i_queue_send();
+    lcd_q_running = 0;
+
+    return status;
+}
+
+/*======================================*/
+/*  描画キューを1転送分送る(本体)		*/
+/*  lcd_q_running を取ってから呼ぶ		*/
+/*======================================*/
+static uint8_t ST7032i_queue_send( void )
+{
+    uint8_t len;
+    uint8_t taken;
+    uint16_t exec_us;
+    uint8_t status;
+
+#ifdef USE_ASYNC_TRANSFER
+    if (lcd_q_taken != 0)
+    {
+        return TINYI2C_BUSY;
+    }
+    if (lcd_q_status != TINYI2C_NO_ERROR)
+    {
+        status = lcd_q_status;              // 失敗は一度返し、次の呼び出しで送り直す
+        lcd_q_status = TINYI2C_NO_ERROR;
+        return status;
+    }
+#endif
+    if (lcd_q_head == lcd_q_tail)
+    {
+        return TINYI2C_NO_ERROR;
+    }
+
+    ST7032i_wait_exec();
+    len = ST7032i_queue_build(&taken, &exec_us);
+
+#ifdef USE_ASYNC_TRANSFER
+    lcd_q_taken = taken;
+    lcd_q_exec = exec_us;
+    lcd_q_job.slave_7bit_addr = ST7032I_ADDR;
+    lcd_q_job.wdata = lcd_q_tx;
+    lcd_q_job.wsize = len;
+    lcd_q_job.rdata = NULL;
+    lcd_q_job.rsize = 0;
+    lcd_q_job.callback = ST7032i_queue_done;
+    if (TinyI2C_submit(lcd_bus, &lcd_q_job) != TINYI2C_NO_ERROR)
+    {
+        lcd_q_taken = 0;                    // 次のティックでやり直す
+    }
+
+    return TINYI2C_BUSY;
+#else
+    status = TinyI2C_write_data(lcd_bus, ST7032I_ADDR, lcd_q_tx, len, SEND_STOP);
+    ST7032i_issued(exec_us);
+    if (status != TINYI2C_NO_ERROR)
+    {
+        return status;
+    }
+    ST7032i_queue_drop(taken);
+
+    return (lcd_q_head == lcd_q_tail) ? TINYI2C_NO_ERROR : TINYI2C_BUSY;
+#endif
+}
+
+/*======================================*/
+/*  描画キューに1段積む					*/
+/*======================================*/
+static uint8_t ST7032i_queue_put( uint8_t data, uint8_t mode )
+{
+    uint8_t next;
+
+    next = lcd_q_tail + 1;
+    if (next == ST7032I_QUEUE_SIZE)
+    {
+        next = 0;
+    }
+    if (next == lcd_q_head)
+    {
+        return TINYI2C_QUEUE_FULL;
+    }
+
+    lcd_q_mode[lcd_q_tail] = mode;
+    lcd_q_data[lcd_q_tail] = data;
+    lcd_q_tail = next;
+
+    return TINYI2C_NO_ERROR;
+}
+
+/*======================================*/
+/*  先頭から1転送分を lcd_q_tx に組む	*/
+/*  [0x80,命令]...[0x40,文字...]		*/
+/*  1.08msかかる命令はそこで打ち切る	*/
+/*  taken: 使った段数					*/
+/*  exec_us: 最後の命令の実行時間		*/
+/*  戻値: 転送バイト数					*/
+/*======================================*/
+static uint8_t ST7032i_queue_build( uint8_t *taken, uint16_t *exec_us )
+{
+    uint8_t i, len, n;
+
+    i = lcd_q_head;
+    len = 0;
+    n = 0;
+    *exec_us = ST7032I_EXEC_US;
+
+    // 命令はCo=1で1つずつつなぐ
+    while (i != lcd_q_tail && !(lcd_q_mode[i] & ST7032I_CTRL_DATA) && len + 2 <= ST7032I_QUEUE_TX)
+    {
+        lcd_q_tx[len++] = ST7032I_CTRL_CMD_MORE;
+        lcd_q_tx[len++] = lcd_q_data[i];
+        *exec_us = ST7032I_EXEC_TIME(lcd_q_data[i]);
+        n++;
+        if (++i == ST7032I_QUEUE_SIZE)
+        {
+            i = 0;
+        }
+        if (*exec_us != ST7032I_EXEC_US)
+        {
+            break;                          // 次は実行が終わってから
+        }
+    }
+
+    // 続く文字は制御バイト1つの後にまとめる
+    if (*exec_us == ST7032I_EXEC_US && i != lcd_q_tail && (lcd_q_mode[i] & ST7032I_CTRL_DATA) && len + 2 <= ST7032I_QUEUE_TX)
+    {
+        lcd_q_tx[len++] = ST7032I_CTRL_DATA;
+        while (i != lcd_q_tail && (lcd_q_mode[i] & ST7032I_CTRL_DATA) && len < ST7032I_QUEUE_TX)
+        {
+            lcd_q_tx[len++] = lcd_q_data[i];
+            n++;
+            if (++i == ST7032I_QUEUE_SIZE)
+            {
+                i = 0;
+            }
+        }
+    }
+    else
+    {
+        lcd_q_tx[len - 2] &= ~ST7032I_CTRL_CO;	// 最後の命令
+    }
+
+    *taken = n;
+    return len;
+}
+
+/*======================================*/
+/*  送った段をキューから外す			*/
+/*======================================*/
+static void ST7032i_queue_drop( uint8_t taken )
+{
+    uint8_t head;
+
+    head = lcd_q_head + taken;
+    if (head >= ST7032I_QUEUE_SIZE)
+    {
+        head -= ST7032I_QUEUE_SIZE;
+    }
+    lcd_q_head = head;
+}
+
+#ifdef USE_ASYNC_TRANSFER
+/*======================================*/
+/*  描画キューの転送完了(割り込み内)	*/
+/*  成功したら続きを送る 長い命令の後	*/
+/*  と失敗したとき、ST7032i_queue_run()	*/
+/*  の途中に割り込んだときは次のティック*/
+/*  に任せる							*/
+/*======================================*/
+static void ST7032i_queue_done( TINYI2C_JOB *job )
+{
+    ST7032i_issued(lcd_q_exec);
+    if (job->status == TINYI2C_NO_ERROR)
+    {
+        ST7032i_queue_drop(lcd_q_taken);
+    }
+    else
+    {
+        lcd_q_status = job->status;
+    }
+    lcd_q_taken = 0;
+
+    if (job->status == TINYI2C_NO_ERROR && lcd_q_exec == ST7032I_EXEC_US)
+    {
+        ST7032i_queue_run();
+    }
+}
+#endif
+#endif
+
+#ifdef USE_POLLED_TRANSFER
+/*======================================*/
+/*  文字列出力の開始(ノンブロッキング)	*/
+/*  位置指定と文字列を1回の転送で送る	*/
+/*  完了までST7032i_poll()を呼ぶこと	*/
+/*  戻値: TINYI2C_BUSY=描画キューか		*/
+/*  前の転送が残っている(後で呼び直す)	*/
+/*  前の命令の実行待ちはバスに任せる	*/
+/*======================================*/
+uint8_t ST7032i_puts_begin(uint8_t col, uint8_t row, const char *s)
+{
+    static const uint8_t row_offsets[] = { 0x00, 0x40 };
+    uint8_t n;
+    uint8_t status;
+    uint16_t left;
+
+#ifdef USE_ST7032I_QUEUE
+    status = ST7032i_queue_run();           // 積んであるものを先に送る
+    if (status != TINYI2C_NO_ERROR)
+    {
+        return status;
+    }
+#endif
+    status = TinyI2C_begin(lcd_bus, &lcd_job);  // 送信中のバッファは書き換えない
+    if (status != TINYI2C_NO_ERROR)
+    {
+        return status;
+    }
+
+    if ( row >= ST7032_NUM_LINES )
+    {
+        row = ST7032_NUM_LINES - 1;
+    }
+
+    lcd_poll_buf[0] = ST7032I_CTRL_CMD_MORE;
+    lcd_poll_buf[1] = LCD_SETDDRAMADDR | (col + row_offsets[row]);
+    lcd_poll_buf[2] = ST7032I_CTRL_DATA;
+    for (n = 0; n < ST7032I_POLL_COLS && s[n] != '\0'; n++)
+    {
+        lcd_poll_buf[3 + n] = s[n];
+    }
+
+    lcd_job.slave_7bit_addr = ST7032I_ADDR;
+    lcd_job.wdata = lcd_poll_buf;
+    lcd_job.wsize = 3 + n;
+    lcd_job.rdata = NULL;
+    lcd_job.rsize = 0;
+    lcd_job.callback = NULL;
+
+    left = ST7032i_exec_left();
+    TinyI2C_poll_delay(lcd_bus, left);      // 実行が終わるまでスタートを遅らせる
+    ST7032i_issued(left + ST7032I_EXEC_US);	// 完了はもっと後なので開始時に記録してよい
+    return TINYI2C_NO_ERROR;
+}
+
+/*======================================*/
+/*  ノンブロッキング転送を進める		*/
+/*  TINYI2C_BUSY の間は呼び続ける		*/
+/*======================================*/
+uint8_t ST7032i_poll( void )
+{
+    return TinyI2C_poll(lcd_bus);
+}
+#endif
+
 #ifdef STRAWBERRY_LINUX_16x2_LCD
 /*======================================*/
 /*  アイコン表示関数					*/
@@ -409,22 +1439,26 @@ void ST7032i_puts_p(const char *progmem_s)
   */
 void ST7032i_Icon(uint8_t number, bool flag)
 {
-	ST7032i_WriteCmd(0b00111001);	// コマンド
+	ST7032I_BATCH batch;
+
+	ST7032i_batch_init(&batch);
+	ST7032i_batch_cmd(&batch, 0b00111001);	// コマンド
 
 	//icon address set
-	ST7032i_WriteCmd(0b01000000 | Icon_Table[number][0] );
+	ST7032i_batch_cmd(&batch, 0b01000000 | Icon_Table[number][0] );
 
 	if(flag)
 	{
 		//icon data set
-		ST7032i_WriteData(Icon_Table[number][1]);
+		ST7032i_batch_data(&batch, Icon_Table[number][1]);
 	}
 	else
 	{
 		//icon data reset
-		ST7032i_WriteData(0x00);
+		ST7032i_batch_data(&batch, 0x00);
 	}
-	ST7032i_WriteCmd(0b00111000);	//
+	ST7032i_batch_cmd(&batch, 0b00111000);	//
+	ST7032i_batch_commit(&batch);
 }
 
 /*======================================*/
@@ -433,6 +1467,7 @@ void ST7032i_Icon(uint8_t number, bool flag)
 void ST7032i_Power_Icon(uint8_t power, bool flag)
 {
 	uint8_t tmp;
+	ST7032I_BATCH batch;
 
 	tmp = 0b00010;	// 枠
 	switch(power)
@@ -452,18 +1487,20 @@ void ST7032i_Power_Icon(uint8_t power, bool flag)
 			break;
 	}
 
-	ST7032i_WriteCmd(0b00111001);	// コマンド
+	ST7032i_batch_init(&batch);
+	ST7032i_batch_cmd(&batch, 0b00111001);	// コマンド
 	//icon address set
-	ST7032i_WriteCmd(0b01000000 | 0x0D );
+	ST7032i_batch_cmd(&batch, 0b01000000 | 0x0D );
 	//icon data set
 	if(flag)
 	{
-		ST7032i_WriteData(tmp);
+		ST7032i_batch_data(&batch, tmp);
 	}
 	else
 	{
-		ST7032i_WriteData(0x00);
+		ST7032i_batch_data(&batch, 0x00);
 	}
-	ST7032i_WriteCmd(0b00111000);	//
+	ST7032i_batch_cmd(&batch, 0b00111000);	//
+	ST7032i_batch_commit(&batch);
 }
 #endif
\ No newline at end of file
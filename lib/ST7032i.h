@@ -2,16 +2,29 @@
 #define __ST7032I__H__
 
 #include <stdbool.h>
+#include "TinyI2CMaster.h"
 
 #define ST7032I_ADDR	0x3E
 
-#define RETRY_ST7032I   3
+#define ST7032I_POLL_COLS	16		// ST7032i_puts_begin() で一度に送る最大文字数
+#define ST7032I_BATCH_MAX	10		// ST7032I_BATCH 1回の転送にまとめる命令/データの最大数
+
+// 待ち時間(データシートの最小値)
+#define ST7032I_POWERON_MS	40		// 電源投入から最初の命令まで
+#define ST7032I_FOLLOWER_MS	200		// フォロワ回路ONから電源が安定するまで
+#define ST7032I_EXEC_US		27		// 一般の命令の実行時間 26.3us(fOSC=380kHz)
+#define ST7032I_EXEC_LONG_US	1080	// LCD_CLEARDISPLAY / LCD_RETURNHOME の実行時間 1.08ms
+// 1usで進む16ビットの時計があれば定義する(前の送信からの経過時間も待ちから差し引く)
+//#define ST7032I_CLOCK_US()	my_micros()
 
 //#define STRAWBERRY_LINUX_16x2_LCD
 #undef STRAWBERRY_LINUX_16x2_LCD
 
 #undef USE_ST7032I_INIT_PORT
 #undef USE_ST7032I_WAKEUP
+//#define USE_ST7032I_FRAMEBUFFER		// 画面のコピーをRAMに持ち、変わった文字だけ ST7032i_flush() で送る
+//#define USE_ST7032I_QUEUE				// 命令と文字をキューに積んで戻り、ST7032i_queue_run() で後から送る
+//#define USE_ST7032I_GLYPH_CACHE		// ユーザ文字をCGRAMの8枠にLRUで割り当てる ST7032i_glyph()
 
 #ifdef USE_ST7032I_INIT_PORT
 	#define ST7032i_WAKE_UP_DDR		DDRB
@@ -111,31 +124,87 @@
 
 #define ST7032_NUM_LINES 			2
 
+#ifdef USE_ST7032I_FRAMEBUFFER
+#ifndef ST7032I_FB_COLS
+#define ST7032I_FB_COLS		16					// フレームバッファの桁数
+#endif
+#define ST7032I_FB_ROWS		ST7032_NUM_LINES	// フレームバッファの行数
+#define ST7032I_FB_RUNS		4					// ST7032i_flush() の1トランザクションで送る変更区間の上限
+#define ST7032I_FB_GAP		3					// これ以下の変わっていない文字を挟む区間は1つにまとめて送る
+#if ST7032I_FB_COLS > 40
+#error "ST7032I_FB_COLS must be 40 or less (DDRAM line length)"
+#endif
+#endif
+
 //======= End of command/flag defenitions =======
 
+#define ST7032I_CGRAM_SLOTS	8		// ユーザ文字(CGRAM)の枠数
+
+#ifdef USE_ST7032I_QUEUE
+#define ST7032I_QUEUE_SIZE	24		// 描画キューの段数(積めるのは1つ少ない数)
+#define ST7032I_QUEUE_TX	20		// 1回の転送の最大バイト数(制御バイトを含む)
+#endif
+
+/*======================================*/
+/*  型定義						        */
+/*======================================*/
+// 命令のバッチ(制御バイトCo=1でつないで1回の転送で送る)
+// 1.08msかかる LCD_CLEARDISPLAY / LCD_RETURNHOME は最後にだけ入れられる
+// (その後の追加は TINYI2C_BAD_MSG ST7032i_WriteCmds() はそこで転送を分ける)
+typedef struct {
+	uint8_t n;								// 登録済みの命令/データ数
+	uint8_t buf[2 * ST7032I_BATCH_MAX];		// 制御バイトと命令/データの組
+} ST7032I_BATCH;
+
 /*======================================*/
 /*  関数定義					        */
 /*======================================*/
+extern void ST7032i_setBus( TINYI2C_BUS *bus );
 extern uint8_t ST7032i_Write( uint8_t data, uint8_t mode );
+extern void ST7032i_batch_init( ST7032I_BATCH *batch );
+extern uint8_t ST7032i_batch_cmd( ST7032I_BATCH *batch, uint8_t cmd );
+extern uint8_t ST7032i_batch_data( ST7032I_BATCH *batch, uint8_t data );
+extern uint8_t ST7032i_batch_commit( ST7032I_BATCH *batch );
+extern uint8_t ST7032i_WriteCmds( const uint8_t *cmds, uint8_t n );
 extern void ST7032i_Init( void );
-extern void ST7032i_Clear( void );
-extern void ST7032i_Home( void );
-extern void ST7032i_setCursor(uint8_t col, uint8_t row);
-extern void ST7032i_onDisplay( void );
-extern void ST7032i_offDisplay( void );
-extern void ST7032i_onCursor( void );
-extern void ST7032i_offCursor( void );
-extern void ST7032i_onBlink( void );
-extern void ST7032i_offBlink( void );
-extern void ST7032i_scrollDisplayLeft( void );
-extern void ST7032i_scrollDisplayRight( void );
-extern void ST7032i_rightToLeft( void );
-extern void ST7032i_onAutoscroll( void );
-extern void ST7032i_offAutoscroll( void );
+extern uint8_t ST7032i_Clear( void );
+extern uint8_t ST7032i_Home( void );
+extern uint8_t ST7032i_setCursor(uint8_t col, uint8_t row);
+extern uint8_t ST7032i_onDisplay( void );
+extern uint8_t ST7032i_offDisplay( void );
+extern uint8_t ST7032i_onCursor( void );
+extern uint8_t ST7032i_offCursor( void );
+extern uint8_t ST7032i_onBlink( void );
+extern uint8_t ST7032i_offBlink( void );
+extern uint8_t ST7032i_scrollDisplayLeft( void );
+extern uint8_t ST7032i_scrollDisplayRight( void );
+extern uint8_t ST7032i_leftToRight( void );
+extern uint8_t ST7032i_rightToLeft( void );
+extern uint8_t ST7032i_onAutoscroll( void );
+extern uint8_t ST7032i_offAutoscroll( void );
 extern void ST7032i_createChar(uint8_t location, uint8_t charmap[]);
 extern void ST7032i_setContrast(uint8_t new_val);
-extern void ST7032i_puts(const char *s);
+extern uint8_t ST7032i_puts(const char *s);
 extern void ST7032i_puts_p(const char *progmem_s);
+#ifdef USE_ST7032I_FRAMEBUFFER
+extern void ST7032i_fb_putc(uint8_t col, uint8_t row, char c);
+extern void ST7032i_fb_puts(uint8_t col, uint8_t row, const char *s);
+extern void ST7032i_fb_clear( void );
+extern void ST7032i_fb_invalidate( void );
+extern uint8_t ST7032i_flush( void );
+#endif
+#ifdef USE_ST7032I_GLYPH_CACHE
+extern uint8_t ST7032i_glyph(const uint8_t *charmap);
+extern void ST7032i_glyph_reset( void );
+#endif
+#ifdef USE_ST7032I_QUEUE
+extern uint8_t ST7032i_queue_free( void );
+extern uint8_t ST7032i_queue_run( void );
+#endif
+#ifdef USE_POLLED_TRANSFER
+extern uint8_t ST7032i_puts_begin(uint8_t col, uint8_t row, const char *s);
+extern uint8_t ST7032i_poll( void );
+#endif
 
 #define ST7032i_WriteCmd(data)		ST7032i_Write(data,0x00)
 #define ST7032i_WriteData(data)		ST7032i_Write(data,0x40)
@@ -1,9 +1,10 @@
 //========================================================================
 // File Name    : TinyI2CMaster.c
 //
-// Title        : ATtiny用 USIを使ったI2Cドライバ
+// Title        : ATtiny用 I2Cドライバ(プロトコル層)
 // Revision     : 0.11
-// Notes        :
+// Notes        : バスの操作は TinyI2C_start/stop/read/write を通して
+//                各バスのバックエンド(TinyI2CMaster_USI.c 等)に任せる
 // Target MCU   : AVR ATtiny series
 // Tool Chain   :
 //
@@ -13,445 +14,1742 @@
 // ????/??/??   がた老さん  soft_I2C.c開発完了
 // 2013/04/10   ばんと      修正完了
 // 2013/04/26   ばんと      レジスタ操作関数追加&変更
+// 2026/10/17   ばんと      USI割り込みによる非同期転送追加
+// 2026/10/17   ばんと      F_CPUから求める通信速度プロファイル追加
+// 2026/10/17   ばんと      メッセージ配列による一括転送追加
+// 2026/10/17   ばんと      クロックストレッチ待ちのタイムアウトとバスクリア追加
+// 2026/10/17   ばんと      複数レジスタ連続読み書き(8/16ビットアドレス)追加
+// 2026/10/17   ばんと      レジスタ・シャドウキャッシュ追加
+// 2026/10/17   ばんと      ビット操作の一括適用(バッチ)追加
+// 2026/10/17   ばんと      USI依存部をTinyI2CMaster_USI.cへ分離
+// 2026/10/17   ばんと      バス統計(スレーブごとのカウンタ)追加
+// 2026/10/17   ばんと      バスを引数で指定する形に変更(複数バス対応)
+// 2026/10/17   ばんと      リトライを方針(TINYI2C_RETRY)に一本化 STOPがエラーを上書きする不具合修正
+// 2026/10/17   ばんと      コールバックで1バイトずつ受け渡すストリーム転送追加
+// 2026/10/17   ばんと      プログラムメモリ(PROGMEM)から直接送る書き込み追加
+// 2026/10/17   ばんと      TinyI2C_poll()で少しずつ進めるノンブロッキング転送追加
+// 2026/10/17   ばんと      アービトレーション負け/バス使用中ではSTOPを送らないようにした
+// 2026/10/17   ばんと      SMBusのコマンド/ブロック転送とPEC(CRC-8)追加
+// 2026/10/17   ばんと      一括転送でNOSTARTの区間の向きを検査(不正な組み合わせはTINYI2C_BAD_MSG)
+// 2026/10/17   ばんと      統計: その他の枠でもストレッチを消費、バックオフ時間とTINYI2C_CLOCK_USによる実測を追加
+// 2026/10/17   ばんと      TinyI2C_poll()のバックオフを呼び出しをまたいで待つようにした(ブロックしない)
+// 2026/10/17   ばんと      マルチマスター: 初期化でバスを持っていない状態にする
+// 2026/10/17   ばんと      読み込みのループがタイムアウトの後も読み続ける不具合修正
+// 2026/10/17   ばんと      一括転送: 区間が0ならバスに触らず戻る(STARTなしのSTOPを送っていた)
 //------------------------------------------------------------------------
 // This code is distributed under Apache License 2.0 License
 //		which can be found at http://www.apache.org/licenses/
 //========================================================================
 
 /* Includes -------------------------------------------------------------*/
-#include <avr/io.h>
-#include <avr/delay.h>
+#include <stddef.h>
 #include "TinyI2CMaster.h"
+#ifdef __AVR__
+#include <avr/pgmspace.h>
+#endif
 
 /* local define ---------------------------------------------------------*/
-#define NO_MORE_READ    0
-#define MORE_READ       1
-
-#define TOGL_USICR      ((0<<USISIE)|(0<<USIOIE)|(1<<USIWM1)|(0<<USIWM0)|(1<<USICS1)|(0<<USICS0)|(1<<USICLK)|(1<<USITC))
-#define TEMP_USISR_8    ((1<<USISIF)|(1<<USIOIF)|(1<<USIPF)|(1<<USIDC)|(0x0<<USICNT0))
-#define TEMP_USISR_1    ((1<<USISIF)|(1<<USIOIF)|(1<<USIPF)|(1<<USIDC)|(0xE<<USICNT0))
-
+#ifdef USE_POLLED_TRANSFER
+// TinyI2C_poll() 1回で行うフェーズ
+#define POLL_START      0       // スタートコンディション
+#define POLL_WADDR      1       // 送信宣言
+#define POLL_TX         2       // データ1バイト送信(全部送ったらリピートスタートかSTOPへ)
+#define POLL_RADDR      3       // 受信宣言
+#define POLL_RX         4       // データ1バイト受信
+#define POLL_STOP       5       // ストップコンディション
+#endif
+#ifdef USE_SMBUS
+// PECのCRC-8(多項式 x^8+x^2+x+1 初期値0) 1バイト分の更新
+#ifdef USE_SMBUS_CRC_NIBBLE
+#define SMBUS_CRC8(crc, data)   TinyI2C_crc8_nibble((crc) ^ (data))
+#else
+#define SMBUS_CRC8(crc, data)   pgm_read_byte(&smbus_crc8_table[(uint8_t)((crc) ^ (data))])
+#endif
+#endif
 /* local typedef --------------------------------------------------------*/
 /* local macro ----------------------------------------------------------*/
+// バス統計 USE_TINYI2C_STATS が無いときは何も生成しない
+#ifdef USE_TINYI2C_STATS
+#ifdef TINYI2C_CLOCK_US
+#define STATS_BEGIN()               (stats_out = stats_in = stats_retries = 0, stats_t0 = (uint16_t)TINYI2C_CLOCK_US())
+#else
+#define STATS_BEGIN()               (stats_out = stats_in = stats_retries = 0)
+#endif
+#define STATS_OUT()                 (stats_out++)
+#define STATS_IN()                  (stats_in++)
+#define STATS_RETRY()               (stats_retries++)
+#define STATS_END(addr, status)     TinyI2C_stats_record(bus, addr, status, spent)
+#else
+#define STATS_BEGIN()               ((void)0)
+#define STATS_OUT()                 ((void)0)
+#define STATS_IN()                  ((void)0)
+#define STATS_RETRY()               ((void)0)
+#define STATS_END(addr, status)     ((void)0)
+#endif
+
+/* variables ------------------------------------------------------------*/
+// 既定のバス(TINYI2C_BACKEND で選んだバックエンド)
+#if TINYI2C_BACKEND == TINYI2C_BACKEND_USI
+TINYI2C_BUS TinyI2C_bus0 = TINYI2C_BUS_USI;
+#elif TINYI2C_BACKEND == TINYI2C_BACKEND_GPIO
+TINYI2C_BUS TinyI2C_bus0 = TINYI2C_BUS_GPIO_REGS(TINYI2C_GPIO_SDA_DDR, TINYI2C_GPIO_SDA_PORT, TINYI2C_GPIO_SDA_PIN, TINYI2C_GPIO_SDA_BIT,
+                                                 TINYI2C_GPIO_SCL_DDR, TINYI2C_GPIO_SCL_PORT, TINYI2C_GPIO_SCL_PIN, TINYI2C_GPIO_SCL_BIT);
+#else
+TINYI2C_BUS TinyI2C_bus0 = TINYI2C_BUS_SIM;
+#endif
+
+// 既定のリトライ方針
+const TINYI2C_RETRY TinyI2C_retry_default =
+{
+    RETRY,
+    TINYI2C_RETRY_BACKOFF_US,
+    TINYI2C_RETRY_BUDGET_US,
+    TINYI2C_RETRY_ON(TINYI2C_UNKNOWN_START) | TINYI2C_RETRY_ON(TINYI2C_UNKNOWN_STOP) |
+    TINYI2C_RETRY_ON(TINYI2C_DATA_COLLISION) | TINYI2C_RETRY_ON(TINYI2C_SLAVE_NACK) |
+    TINYI2C_RETRY_ON(TINYI2C_ARBITRATION_LOST) | TINYI2C_RETRY_ON(TINYI2C_BUS_BUSY) |
+    TINYI2C_RETRY_ON(TINYI2C_PEC_ERROR),
+};
+
 /* local variables ------------------------------------------------------*/
-/* local function prototypes --------------------------------------------*/
+#ifdef USE_REGISTER_CACHE
+static TINYI2C_REGCACHE *cache_list;                // 登録済みキャッシュのリスト
+#endif
+#ifdef USE_SMBUS
+#ifdef USE_SMBUS_CRC_NIBBLE
+// CRC-8 4ビット分の表(上位ニブルごと)
+static const uint8_t smbus_crc8_table[16] PROGMEM =
+{
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+};
+#else
+// CRC-8 1バイト分の表
+static const uint8_t smbus_crc8_table[256] PROGMEM =
+{
+    0x00, 0x07, 0x0E, 0x09, 0x1C, 0x1B, 0x12, 0x15, 0x38, 0x3F, 0x36, 0x31, 0x24, 0x23, 0x2A, 0x2D,
+    0x70, 0x77, 0x7E, 0x79, 0x6C, 0x6B, 0x62, 0x65, 0x48, 0x4F, 0x46, 0x41, 0x54, 0x53, 0x5A, 0x5D,
+    0xE0, 0xE7, 0xEE, 0xE9, 0xFC, 0xFB, 0xF2, 0xF5, 0xD8, 0xDF, 0xD6, 0xD1, 0xC4, 0xC3, 0xCA, 0xCD,
+    0x90, 0x97, 0x9E, 0x99, 0x8C, 0x8B, 0x82, 0x85, 0xA8, 0xAF, 0xA6, 0xA1, 0xB4, 0xB3, 0xBA, 0xBD,
+    0xC7, 0xC0, 0xC9, 0xCE, 0xDB, 0xDC, 0xD5, 0xD2, 0xFF, 0xF8, 0xF1, 0xF6, 0xE3, 0xE4, 0xED, 0xEA,
+    0xB7, 0xB0, 0xB9, 0xBE, 0xAB, 0xAC, 0xA5, 0xA2, 0x8F, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9D, 0x9A,
+    0x27, 0x20, 0x29, 0x2E, 0x3B, 0x3C, 0x35, 0x32, 0x1F, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0D, 0x0A,
+    0x57, 0x50, 0x59, 0x5E, 0x4B, 0x4C, 0x45, 0x42, 0x6F, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7D, 0x7A,
+    0x89, 0x8E, 0x87, 0x80, 0x95, 0x92, 0x9B, 0x9C, 0xB1, 0xB6, 0xBF, 0xB8, 0xAD, 0xAA, 0xA3, 0xA4,
+    0xF9, 0xFE, 0xF7, 0xF0, 0xE5, 0xE2, 0xEB, 0xEC, 0xC1, 0xC6, 0xCF, 0xC8, 0xDD, 0xDA, 0xD3, 0xD4,
+    0x69, 0x6E, 0x67, 0x60, 0x75, 0x72, 0x7B, 0x7C, 0x51, 0x56, 0x5F, 0x58, 0x4D, 0x4A, 0x43, 0x44,
+    0x19, 0x1E, 0x17, 0x10, 0x05, 0x02, 0x0B, 0x0C, 0x21, 0x26, 0x2F, 0x28, 0x3D, 0x3A, 0x33, 0x34,
+    0x4E, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5C, 0x5B, 0x76, 0x71, 0x78, 0x7F, 0x6A, 0x6D, 0x64, 0x63,
+    0x3E, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2C, 0x2B, 0x06, 0x01, 0x08, 0x0F, 0x1A, 0x1D, 0x14, 0x13,
+    0xAE, 0xA9, 0xA0, 0xA7, 0xB2, 0xB5, 0xBC, 0xBB, 0x96, 0x91, 0x98, 0x9F, 0x8A, 0x8D, 0x84, 0x83,
+    0xDE, 0xD9, 0xD0, 0xD7, 0xC2, 0xC5, 0xCC, 0xCB, 0xE6, 0xE1, 0xE8, 0xEF, 0xFA, 0xFD, 0xF4, 0xF3,
+};
+#endif
+#endif
+#ifdef USE_TINYI2C_STATS
+static TINYI2C_STATS stats_table[TINYI2C_STATS_SLOTS];
+static uint16_t stats_out;                          // 実行中トランザクションの送信バイト
+static uint16_t stats_in;                           // 実行中トランザクションの受信バイト
+static uint8_t  stats_retries;                      // 実行中トランザクションのリトライ回数
+#ifdef TINYI2C_CLOCK_US
+static uint16_t stats_t0;                           // 実行中トランザクションの開始時刻(us)
+#endif
+#endif
 
-/* [ここからがた老さんのソース] ======================================== */
+/* local function prototypes --------------------------------------------*/
+#ifdef USE_READ_WRITE_REPEAT
+#ifdef USE_SMBUS
+static uint8_t TinyI2C_smbus_xfer( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t cmd, uint8_t *buf, uint8_t size, uint8_t *count, uint8_t flags );
+#ifdef USE_SMBUS_CRC_NIBBLE
+static uint8_t TinyI2C_crc8_nibble( uint8_t crc );
+#endif
+#endif
+static uint8_t TinyI2C_finish( TINYI2C_BUS *bus, uint8_t status, uint8_t send_stop );
+static uint8_t TinyI2C_retry_wait( TINYI2C_BUS *bus, uint8_t status, uint8_t attempt, uint16_t *spent );
+static uint8_t TinyI2C_retry_next( TINYI2C_BUS *bus, uint8_t status, uint8_t attempt, uint16_t *spent, uint16_t *wait );
+static uint8_t TinyI2C_write_flash( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, const uint8_t *head, uint8_t head_size, const uint8_t *progmem_data, int size, uint8_t send_stop );
+#ifdef USE_POLLED_TRANSFER
+static uint8_t TinyI2C_poll_step( TINYI2C_BUS *bus, TINYI2C_JOB *job );
+static uint8_t TinyI2C_poll_waiting( TINYI2C_BUS *bus );
+#endif
+#endif
+#ifdef USE_REGISTER_CACHE
+static TINYI2C_REGCACHE *TinyI2C_cache_find( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t reg );
+static void TinyI2C_cache_store( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t reg, const uint8_t *data, uint8_t size );
+#endif
+#ifdef USE_TINYI2C_STATS
+static void TinyI2C_stats_record( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t status, uint16_t spent );
+#endif
 
+/* [ここからばんとのソース] ============================================ */
 //========================================================================
-//  USIインタフェースの初期化(対応ポートも初期化)
+//  バスの初期化(対応ポートも初期化)
 //------------------------------------------------------------------------
-// 引数: なし
+// 引数: TINYI2C_BUS *bus : 初期化するバス(TINYI2C_BUS_xxx で定義したもの)
 // 戻値: なし
+// 備考: 使うバスごとに1回呼ぶこと
 //========================================================================
-void TinyI2C_Master_init( void )
+void TinyI2C_Master_init( TINYI2C_BUS *bus )
 {
-    USIDR = 0xFF;                          //release data reg
-
-    PORT_USI  |=(1<<PIN_USI_SCL)|(1<<PIN_USI_SDA); //ピンは内部プルアップ
-    DDR_USI   |=(1<<PIN_USI_SCL)|(1<<PIN_USI_SDA); //最初は出力方向にしておく
-
-    // 2wire mode  ソフトウエアクロック 最初はエッジでトグルしない(USITC=0)
-    USICR = TOGL_USICR;
-    USICR &= ~(1<<USITC);
-
-    //ステイタスレジスタはすべてクリア
-    USISR = TEMP_USISR_8;
+    if (bus->timeout == 0)
+    {
+        bus->timeout = TINYI2C_TIMEOUT_US;
+    }
+    bus->error = TINYI2C_NO_ERROR;
+#ifdef USE_MULTI_MASTER
+    bus->owned = 0;
+    bus->foreign = 0;
+#endif
+#ifdef USE_POLLED_TRANSFER
+    bus->poll_job = NULL;
+#endif
+    bus->ops->init(bus);
 }
 
+#ifdef USE_READ_WRITE_REPEAT
 //========================================================================
-//  スタートコンディション送信
+//  データ連続読み込み
 //------------------------------------------------------------------------
-// 引数: なし
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       void* data              : 読み込むデータ
+//       int size                : 読み込むデータサイズ
+//       uint8_t send_stop       : 非0なら読込後にSTOPコンディション送信する
 // 戻値: 0=正常終了　それ以外I2C通信エラー
+// 備考: 失敗したときはバスのリトライ方針に従ってやり直す
 //========================================================================
-uint8_t TinyI2C_start( void )
+uint8_t TinyI2C_read_data(TINYI2C_BUS *bus, uint8_t slave_7bit_addr, void* data, int size, uint8_t send_stop )
 {
-#ifdef NOISE_TESTING                                // Test if any unexpected conditions have arrived prior to this execution.
-    if( USISR & (1<<USISIF) )
-    {
-        return TINYI2C_UNKNOWN_START;
-    }
-
-    if( USISR & (1<<USIPF) )
-    {
-        return TINYI2C_UNKNOWN_STOP;
-    }
+    uint8_t i;
+    uint8_t status;
+    uint8_t *p;
+    uint16_t spent;
+    int n;
 
-    if( USISR & (1<<USIDC) )
+    STATS_BEGIN();
+    for (i = 0, spent = 0; ; i++)
     {
-        return TINYI2C_DATA_COLLISION;
-    }
-#endif
-
-    PORT_USI |= (1<<PIN_USI_SCL);               //set SCL 1
-    while( !(PIN_USI & (1<<PIN_USI_SCL)) );     //wait SCL high
-    _delay_us(T2_TWI);
-    PORT_USI &= ~(1<<PIN_USI_SDA);              // Force SDA LOW
-    _delay_us(T4_TWI);
-    PORT_USI &= ~(1<<PIN_USI_SCL);              //Pull SCL low
-    PORT_USI |=  (1<<PIN_USI_SDA);              //Release SDA
+        // スタートコンディション発行
+        status = TinyI2C_start(bus);
+        if (status == TINYI2C_NO_ERROR)
+        {
+            // マスターの受信宣言
+            status = TinyI2C_write(bus, (slave_7bit_addr<<1) | 0x01);
+            STATS_OUT();
+        }
+        if (status == TINYI2C_NO_ERROR)
+        {
+            for (p = data, n = size; n > 0 && TinyI2C_getStatus(bus) == TINYI2C_NO_ERROR; --n)
+            {
+                *p++ = TinyI2C_read(bus, (n == 1) ? NO_MORE_READ : MORE_READ);
+                STATS_IN();
+            }
+            status = TinyI2C_getStatus(bus);
+        }
 
-#ifdef SIGNAL_VERIFY
-    if(!(USISR & (1<<USISIF)))
-    {
-        return TINYI2C_MISS_START_COND;
+        status = TinyI2C_finish(bus, status, send_stop);
+        if (!TinyI2C_retry_wait(bus, status, i, &spent))
+        {
+            break;
+        }
+        STATS_RETRY();
     }
-#endif
 
-    return TINYI2C_NO_ERROR;
+    STATS_END(slave_7bit_addr, status);
+    return status;
 }
 
-
 //========================================================================
-//  ストップコンディションの送信
+//  データ連続書き込み
 //------------------------------------------------------------------------
-// 引数: なし
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       void* data              : 書き込むデータ
+//       int size                : 書き込むデータサイズ
+//       uint8_t send_stop       : 非0なら読込後にSTOPコンディション送信する
 // 戻値: 0=正常終了　それ以外I2C通信エラー
+// 備考: 失敗したときはバスのリトライ方針に従ってやり直す
 //========================================================================
-uint8_t TinyI2C_stop( void )
+uint8_t TinyI2C_write_data(TINYI2C_BUS *bus, uint8_t slave_7bit_addr, void* data, int size, uint8_t send_stop)
 {
-    uint8_t retval;
-
-    retval = TINYI2C_NO_ERROR;
+    uint8_t i;
+    uint8_t status;
+    uint8_t *p;
+    uint16_t spent;
+    int n;
 
-    PORT_USI &= ~(1<<PIN_USI_SDA);              //pull SDA low
-    PORT_USI |=  (1<<PIN_USI_SCL);              //Release SCL
-    while( !(PIN_USI & (1<<PIN_USI_SCL)) );     //wait SCL high
-    _delay_us(T2_TWI);
-    PORT_USI |= (1<<PIN_USI_SDA);               // set SDA in High(Z)
-    _delay_us(T4_TWI);
-#ifdef SIGNAL_VERIFY
-    if(!(USISR & (1<<USIPF)) )
+    STATS_BEGIN();
+    for (i = 0, spent = 0; ; i++)
     {
-        retval = TINYI2C_MISS_STOP_COND;
+        // スタートコンディション発行
+        status = TinyI2C_start(bus);
+        if (status == TINYI2C_NO_ERROR)
+        {
+            // マスターの送信宣言
+            status = TinyI2C_write(bus, (slave_7bit_addr<<1) | 0x00);
+            STATS_OUT();
+        }
+        for (p = data, n = size; n > 0 && status == TINYI2C_NO_ERROR; --n)
+        {
+            status = TinyI2C_write(bus, *p++ );
+            STATS_OUT();
+        }
+
+        status = TinyI2C_finish(bus, status, send_stop);
+        if (!TinyI2C_retry_wait(bus, status, i, &spent))
+        {
+            break;
+        }
+        STATS_RETRY();
     }
-#endif
-    USISR |= (1<<USIPF);                        //clear stop condition
 
-    return retval;
+    STATS_END(slave_7bit_addr, status);
+    return status;
 }
 
-
 //========================================================================
-//  1バイト読み込み(読み込み宣言のあと）
+//  データ連続書き込み(プログラムメモリから)
 //------------------------------------------------------------------------
-// 引数: uint8_t more: more が MORE_READのときACK送信、それ以外はNACK送信
-// 戻値: 読み込まれた1バイトのデータ
+// 引数: TINYI2C_BUS *bus           : バス
+//       uint8_t slave_7bit_addr     : ターゲットの7ビットアドレス
+//       const uint8_t *progmem_data : 書き込むデータ(PROGMEM)
+//       int size                    : 書き込むデータサイズ
+//       uint8_t send_stop           : 非0なら書込後にSTOPコンディション送信する
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+// 備考: SRAMにコピーせず、送信しながら1バイトずつ読み出す
 //========================================================================
-uint8_t TinyI2C_read( uint8_t more )
+uint8_t TinyI2C_write_data_P( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, const uint8_t *progmem_data, int size, uint8_t send_stop )
 {
-    uint8_t data;
-
-    DDR_USI &= ~(1<<PIN_USI_SDA);               //enable SDA as input
-    data = TinyI2C_Transfer(TEMP_USISR_8);      //read 8 bits
-    if(more == MORE_READ)                       //if read more
-        USIDR = 0x00;                           //set ACK
-    else
-        USIDR =0xFF;                            // NACK
-    TinyI2C_Transfer(TEMP_USISR_1);             // generate (N)ACK (1bit)
-
-    return data;
+    return TinyI2C_write_flash(bus, slave_7bit_addr, NULL, 0, progmem_data, size, send_stop);
 }
 
-
 //========================================================================
-//  1バイト書き込み
+//  先頭バイト(SRAM)+データ(プログラムメモリ)の書き込み
 //------------------------------------------------------------------------
-// 引数: uint8_t data 書き込むデータ
+// 引数: TINYI2C_BUS *bus           : バス
+//       uint8_t slave_7bit_addr     : ターゲットの7ビットアドレス
+//       const uint8_t *head         : 先に送るデータ(SRAM レジスタアドレス等)
+//       uint8_t head_size           : head のサイズ(0なら送らない)
+//       const uint8_t *progmem_data : 続けて送るデータ(PROGMEM)
+//       int size                    : progmem_data のサイズ
+//       uint8_t send_stop           : 非0なら書込後にSTOPコンディション送信する
 // 戻値: 0=正常終了　それ以外I2C通信エラー
 //========================================================================
-uint8_t TinyI2C_write( uint8_t data )
+static uint8_t TinyI2C_write_flash( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, const uint8_t *head, uint8_t head_size, const uint8_t *progmem_data, int size, uint8_t send_stop )
 {
-    uint8_t retval;
-
-    retval = TINYI2C_NO_ERROR;                  //
+    uint8_t i;
+    uint8_t status;
+    const uint8_t *p;
+    uint16_t spent;
+    int n;
 
-    PORT_USI &= ~(1<<PIN_USI_SCL);              //Pull SCL low
-    USIDR = data;                               //set Data
-    TinyI2C_Transfer(TEMP_USISR_8);
-    DDR_USI &= ~(1<<PIN_USI_SDA);               //入力に切り換え
-    if(TinyI2C_Transfer(TEMP_USISR_1) & 0x01)
+    STATS_BEGIN();
+    for (i = 0, spent = 0; ; i++)
     {
-        retval = TINYI2C_SLAVE_NACK;            //listen to response
+        // スタートコンディション発行
+        status = TinyI2C_start(bus);
+        if (status == TINYI2C_NO_ERROR)
+        {
+            // マスターの送信宣言
+            status = TinyI2C_write(bus, (slave_7bit_addr<<1) | 0x00);
+            STATS_OUT();
+        }
+        for (p = head, n = head_size; n > 0 && status == TINYI2C_NO_ERROR; --n)
+        {
+            status = TinyI2C_write(bus, *p++ );
+            STATS_OUT();
+        }
+        for (p = progmem_data, n = size; n > 0 && status == TINYI2C_NO_ERROR; --n)
+        {
+            status = TinyI2C_write(bus, pgm_read_byte(p++) );
+            STATS_OUT();
+        }
+
+        status = TinyI2C_finish(bus, status, send_stop);
+        if (!TinyI2C_retry_wait(bus, status, i, &spent))
+        {
+            break;
+        }
+        STATS_RETRY();
     }
 
-    return retval;
+    STATS_END(slave_7bit_addr, status);
+    return status;
 }
 
+#ifdef USE_STREAM_TRANSFER
 //========================================================================
-//  USIインタフェースによるデータ送受信 8ビットも1ビットも同じ
+//  ストリーム読み込み(受信バッファなし)
 //------------------------------------------------------------------------
-// 引数: uint8_t data: 送受信データ
+// 引数: TINYI2C_BUS *bus          : バス
+//       uint8_t slave_7bit_addr    : ターゲットの7ビットアドレス
+//       TINYI2C_CONSUMER consume   : 受信した1バイトごとに呼ばれる
+//       void *ctx                  : consume に渡す値
+//       uint16_t size              : 読み込むデータサイズ
+//       uint8_t send_stop          : 非0なら読込後にSTOPコンディション送信する
 // 戻値: 0=正常終了　それ以外I2C通信エラー
+// 備考: consume は次のバイトの受信前に呼ばれる(長い処理はクロックを伸ばす)
+//       途中でタイムアウトしたときはそこで打ち切る(そのバイトは渡さない)
+//       リトライしたときは index 0 から呼び直される
 //========================================================================
-uint8_t TinyI2C_Transfer( uint8_t data )
+uint8_t TinyI2C_read_stream( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, TINYI2C_CONSUMER consume, void *ctx, uint16_t size, uint8_t send_stop )
 {
-    uint8_t retval;
+    uint8_t i;
+    uint8_t status;
+    uint8_t data;
+    uint16_t spent;
+    uint16_t n;
 
-    USISR = data;
-    do
+    STATS_BEGIN();
+    for (i = 0, spent = 0; ; i++)
     {
-        _delay_us(T2_TWI);
-        USICR = TOGL_USICR;                     //generate positive SCL edge
-        while(!(PIN_USI &(1<<PIN_USI_SCL)) );   //wait for SCL to go high
-        _delay_us(T4_TWI);
-        USICR = TOGL_USICR;
-    }
-    while(!(USISR &(1<<USIOIF)) );              //4bitカウンタ終了を待つ
+        // スタートコンディション発行
+        status = TinyI2C_start(bus);
+        if (status == TINYI2C_NO_ERROR)
+        {
+            // マスターの受信宣言
+            status = TinyI2C_write(bus, (slave_7bit_addr<<1) | 0x01);
+            STATS_OUT();
+        }
+        if (status == TINYI2C_NO_ERROR)
+        {
+            for (n = 0; n < size; n++)
+            {
+                data = TinyI2C_read(bus, (n + 1 == size) ? NO_MORE_READ : MORE_READ);
+                STATS_IN();
+                if (TinyI2C_getStatus(bus) != TINYI2C_NO_ERROR)
+                {
+                    break;
+                }
+                consume(ctx, n, data);
+            }
+            status = TinyI2C_getStatus(bus);
+        }
 
-    _delay_us(T2_TWI);
-    retval = USIDR;                             //読み込みのときはデータが入る
-    USIDR = 0xFF;                               //Release SDA
-    DDR_USI |=(1<<PIN_USI_SDA);                 //出力モードに変える
+        status = TinyI2C_finish(bus, status, send_stop);
+        if (!TinyI2C_retry_wait(bus, status, i, &spent))
+        {
+            break;
+        }
+        STATS_RETRY();
+    }
 
-    return retval;
+    STATS_END(slave_7bit_addr, status);
+    return status;
 }
-/* =========================================[ここまでかだ老さんのソース] */
 
-/* [ここからばんとのソース] ============================================ */
-#ifdef USE_READ_WRITE_REPEAT
 //========================================================================
-//  データ連続読み込み
+//  ストリーム書き込み(送信バッファなし)
 //------------------------------------------------------------------------
-// 引数: uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
-//       void* data              : 読み込むデータ
-//       int size                : 読み込むデータサイズ
-//       uint8_t send_stop       : 非0なら読込後にSTOPコンディション送信する
+// 引数: TINYI2C_BUS *bus          : バス
+//       uint8_t slave_7bit_addr    : ターゲットの7ビットアドレス
+//       TINYI2C_PRODUCER produce   : 送信する1バイトごとに呼ばれる
+//       void *ctx                  : produce に渡す値
+//       uint16_t size              : 書き込むデータサイズ
+//       uint8_t send_stop          : 非0なら書込後にSTOPコンディション送信する
 // 戻値: 0=正常終了　それ以外I2C通信エラー
+// 備考: リトライしたときは index 0 から呼び直される
 //========================================================================
-uint8_t TinyI2C_read_data(uint8_t slave_7bit_addr, void* data, int size, uint8_t send_stop )
+uint8_t TinyI2C_write_stream( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, TINYI2C_PRODUCER produce, void *ctx, uint16_t size, uint8_t send_stop )
 {
-    register int    i;
+    uint8_t i;
     uint8_t status;
-    uint8_t *p;
+    uint16_t spent;
+    uint16_t n;
 
-    p= data;
-    for(i = 0; i < RETRY; i++)
+    STATS_BEGIN();
+    for (i = 0, spent = 0; ; i++)
     {
         // スタートコンディション発行
-        status = TinyI2C_start();
-        if (status != TINYI2C_NO_ERROR)
+        status = TinyI2C_start(bus);
+        if (status == TINYI2C_NO_ERROR)
         {
-			// リトライ処理
-			if(status == TINYI2C_UNKNOWN_START)
-           	{
-            	continue;
-			}
-			else if(status == TINYI2C_UNKNOWN_STOP)
-           	{
-            	continue;
-			}
-            else if(status == TINYI2C_DATA_COLLISION)
-           	{
-            	continue;
-			}
-			else
-         	{
-                break;
-			}
+            // マスターの送信宣言
+            status = TinyI2C_write(bus, (slave_7bit_addr<<1) | 0x00);
+            STATS_OUT();
         }
-
-        // マスターの受信宣言
-        status = TinyI2C_write((slave_7bit_addr<<1) | 0x01);
-        if (status !=  TINYI2C_NO_ERROR)
+        for (n = 0; n < size && status == TINYI2C_NO_ERROR; n++)
         {
-            break;
+            status = TinyI2C_write(bus, produce(ctx, n));
+            STATS_OUT();
         }
 
-        for (; size > 0; --size)
+        status = TinyI2C_finish(bus, status, send_stop);
+        if (!TinyI2C_retry_wait(bus, status, i, &spent))
         {
-            if (size==1)
-            {
-                *p = TinyI2C_read(NO_MORE_READ);
-            }
-            else
-            {
-                *p++ = TinyI2C_read(MORE_READ);
-            }
+            break;
         }
-        status = TINYI2C_NO_ERROR;
-        break;
-    }
-
-    // Send stop condition
-    if (send_stop != 0)
-    {
-        status = TinyI2C_stop( );
+        STATS_RETRY();
     }
 
+    STATS_END(slave_7bit_addr, status);
     return status;
 }
+#endif  /* USE_STREAM_TRANSFER */
 
 //========================================================================
-//  データ連続書き込み
+//  メッセージ配列の一括転送
 //------------------------------------------------------------------------
-// 引数: uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
-//       void* data              : 書き込むデータ
-//       int size                : 書き込むデータサイズ
-//       uint8_t send_stop       : 非0なら読込後にSTOPコンディション送信する
+// 引数: TINYI2C_BUS *bus  : バス
+//       TINYI2C_MSG *msgs : 転送する区間の配列
+//       uint8_t n         : 区間の数
 // 戻値: 0=正常終了　それ以外I2C通信エラー
+// 備考: 区間の間はリピートスタート、最後に1回だけSTOPを送信する
+//       TINYI2C_M_NOSTART の区間は同じ向きの前の区間に続けて送る/読む
+//       (先頭の区間や向きが変わる区間に付けたらバスに触らず TINYI2C_BAD_MSG)
+//       失敗したときはバスのリトライ方針に従って全区間を最初からやり直す
+//       n が0ならバスに触らず正常終了
 //========================================================================
-uint8_t TinyI2C_write_data(uint8_t slave_7bit_addr, void* data, int size, uint8_t send_stop)
+uint8_t TinyI2C_transfer_msgs( TINYI2C_BUS *bus, TINYI2C_MSG *msgs, uint8_t n )
 {
-    register int    i;
+    uint8_t i;
     uint8_t status;
+    uint8_t m, k;
+    uint8_t more;
     uint8_t *p;
+    uint16_t spent;
 
-    p = data;
-    for (i = 0; i< RETRY; i++)
+    if (n == 0)
     {
-        // スタートコンディション発行
-        status = TinyI2C_start();
-        if (status !=  TINYI2C_NO_ERROR)
-        {
-			// リトライ処理
-			if(status == TINYI2C_UNKNOWN_START)
-           	{
-            	continue;
-			}
-			else if(status == TINYI2C_UNKNOWN_STOP)
-           	{
-            	continue;
-			}
-            else if(status == TINYI2C_DATA_COLLISION)
-           	{
-            	continue;
-			}
-			else
-         	{
-                break;
-			}
-        }
+        return TINYI2C_NO_ERROR;            // 送るものがない(msgs[0]も読まない)
+    }
 
-        // マスターの送信宣言
-        status = TinyI2C_write((slave_7bit_addr<<1) | 0x00);
-        if (status !=  TINYI2C_NO_ERROR)
+    for (m = 0; m < n; m++)
+    {
+        if ((msgs[m].flags & TINYI2C_M_NOSTART) &&
+            (m == 0 || ((msgs[m].flags ^ msgs[m - 1].flags) & TINYI2C_M_RD)))
         {
-            break;
+            return TINYI2C_BAD_MSG;
         }
+    }
 
-        for(; size > 0; --size)
+    STATS_BEGIN();
+    for (i = 0, spent = 0; ; i++)
+    {
+        status = TINYI2C_NO_ERROR;
+        for (m = 0; m < n && status == TINYI2C_NO_ERROR; m++)
         {
-            status = TinyI2C_write( *p++ );
-            if (status !=  TINYI2C_NO_ERROR)
+            if (!(msgs[m].flags & TINYI2C_M_NOSTART))
             {
-                break;
+                // スタートコンディション発行(2区間目以降はリピートスタート)
+                status = TinyI2C_start(bus);
+                if (status != TINYI2C_NO_ERROR)
+                {
+                    break;
+                }
+
+                status = TinyI2C_write(bus, (msgs[m].slave_7bit_addr<<1) | (msgs[m].flags & TINYI2C_M_RD));
+                STATS_OUT();
+                if (status != TINYI2C_NO_ERROR)
+                {
+                    break;
+                }
+            }
+
+            p = msgs[m].buf;
+            if (msgs[m].flags & TINYI2C_M_RD)
+            {
+                // 次の区間が続きの読み込みなら最後のバイトもACK
+                more = (m + 1 < n && (msgs[m + 1].flags & TINYI2C_M_NOSTART)) ? MORE_READ : NO_MORE_READ;
+                for (k = msgs[m].len; k > 0 && TinyI2C_getStatus(bus) == TINYI2C_NO_ERROR; --k)
+                {
+                    *p++ = TinyI2C_read(bus, (k == 1) ? more : MORE_READ);
+                    STATS_IN();
+                }
+                status = TinyI2C_getStatus(bus);
+            }
+            else
+            {
+                for (k = msgs[m].len; k > 0 && status == TINYI2C_NO_ERROR; --k)
+                {
+                    status = TinyI2C_write(bus, *p++ );
+                    STATS_OUT();
+                }
             }
         }
-        break;
+
+        status = TinyI2C_finish(bus, status, SEND_STOP);
+        if (!TinyI2C_retry_wait(bus, status, i, &spent))
+        {
+            break;
+        }
+        STATS_RETRY();
     }
 
-    // Send stop condition
-    if (send_stop != 0)
+    STATS_END(msgs[0].slave_7bit_addr, status);
+    return status;
+}
+
+//========================================================================
+//  トランザクションの後始末
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus  : バス
+//       uint8_t status    : ここまでの結果
+//       uint8_t send_stop : 非0なら成功時もSTOPコンディション送信する
+// 戻値: 最終結果(STOPの失敗で元のエラーを上書きしない)
+// 備考: タイムアウトならバスクリア(STOPも送られる)、それ以外の失敗はSTOPで
+//       バスを開放する
+//       アービトレーション負け/バス使用中はバスが他のマスターのものなので何もしない
+//========================================================================
+static uint8_t TinyI2C_finish( TINYI2C_BUS *bus, uint8_t status, uint8_t send_stop )
+{
+    uint8_t stop_status;
+
+    if (status == TINYI2C_TIMEOUT)
+    {
+        TinyI2C_busClear(bus);
+    }
+    else if (status == TINYI2C_ARBITRATION_LOST || status == TINYI2C_BUS_BUSY)
+    {
+        // バスは他のマスターのもの STOPもバスクリアもしない
+    }
+    else if (status != TINYI2C_NO_ERROR || send_stop != 0)
     {
-        status = TinyI2C_stop( );
+        stop_status = TinyI2C_stop(bus);
+        if (status == TINYI2C_NO_ERROR)
+        {
+            status = stop_status;
+        }
     }
 
     return status;
 }
 
-#ifdef USE_READ_WRITE_REGISTER
 //========================================================================
-//  レジスタ読み込み
+//  リトライするか判定し、するならバックオフ時間だけ待つ
 //------------------------------------------------------------------------
-// 引数: uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
-//       uint8_t mem_addr        : レジスタのメモリアドレス
-//       uint8_t* data           : 読み込むデータ
-// 戻値: 0=正常終了　それ以外I2C通信エラー
+// 引数: TINYI2C_BUS *bus : バス
+//       uint8_t status   : 今回の結果
+//       uint8_t attempt  : 今回の試行(0から)
+//       uint16_t *spent  : このトランザクションで待った時間の合計(us)
+// 戻値: 非0=やり直す 0=終了
 //========================================================================
-uint8_t TinyI2C_readReg( uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t *data )
+static uint8_t TinyI2C_retry_wait( TINYI2C_BUS *bus, uint8_t status, uint8_t attempt, uint16_t *spent )
 {
-    uint8_t status;
+    uint16_t wait;
 
-    // アドレス送信
-    status = TinyI2C_write_data(slave_7bit_addr, &mem_addr, 1, NO_SEND_STOP);
-    if(status != TINYI2C_NO_ERROR)
+    if (!TinyI2C_retry_next(bus, status, attempt, spent, &wait))
     {
-        return status;
+        return 0;
+    }
+
+    if (wait != 0)
+    {
+        bus->ops->idle(bus, wait);
     }
+    TinyI2C_clearStatus(bus);                   //異常フラグをクリアしてやり直し
 
-    return TinyI2C_read_data(slave_7bit_addr, data, 1, SEND_STOP);
+    return 1;
 }
 
 //========================================================================
-//  レジスタマスク書き込み
+//  リトライするか判定し、バックオフ時間を求める
 //------------------------------------------------------------------------
-// 引数: uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
-//       uint8_t mem_addr        : レジスタのメモリアドレス
-//       uint8_t mask            : 設定するビットのマスクデータ
-//       uint8_t set_bit         : 設定データ
-// 戻値: 0=正常終了 それ以外I2C通信エラー
+// 引数: TINYI2C_BUS *bus : バス
+//       uint8_t status   : 今回の結果
+//       uint8_t attempt  : 今回の試行(0から)
+//       uint16_t *spent  : このトランザクションで待った時間の合計(us) waitを足す
+//       uint16_t *wait   : やり直す前に待つ時間(us)
+// 戻値: 非0=やり直す 0=終了
+// 備考: 待つのは呼び出し側
 //========================================================================
-uint8_t TinyI2C_masksetRegBit( uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t mask, uint8_t set_bit )
+static uint8_t TinyI2C_retry_next( TINYI2C_BUS *bus, uint8_t status, uint8_t attempt, uint16_t *spent, uint16_t *wait )
 {
-    uint8_t data[2];
-    uint8_t status;
+    const TINYI2C_RETRY *policy;
 
-    data[0] = mem_addr;
-    status = TinyI2C_readReg(slave_7bit_addr, data[0], &data[1] );
-    if(status != TINYI2C_NO_ERROR)
+    if (status == TINYI2C_NO_ERROR)
     {
-        return status;
+        return 0;
+    }
+
+    policy = (bus->retry != NULL) ? bus->retry : &TinyI2C_retry_default;
+    if (attempt + 1 >= policy->attempts || !(policy->retry_mask & TINYI2C_RETRY_ON(status)))
+    {
+        return 0;
     }
-    data[1] &= ~mask;
-    data[1] |= set_bit;
 
-    return TinyI2C_write_data(slave_7bit_addr, data, 2, SEND_STOP);
+    *wait = (attempt < 8) ? (policy->backoff_us << attempt) : 0xFFFF;
+    if (*wait < policy->backoff_us || (uint32_t)*spent + *wait > policy->budget_us)
+    {
+        return 0;                               //待ち時間の上限を超える
+    }
+    *spent += *wait;
+
+    return 1;
 }
 
+#ifdef USE_POLLED_TRANSFER
 //========================================================================
-//  特定ビット設定
+//  ポーリング転送の開始
 //------------------------------------------------------------------------
-// 引数: uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
-//       uint8_t mem_addr        : レジスタのメモリアドレス
-//       uint8_t set_bit         : 設定するビットの位置
-// 戻値: 0=正常終了 それ以外I2C通信エラー
+// 引数: TINYI2C_BUS *bus : バス
+//       TINYI2C_JOB *job : 転送記述子(完了まで呼び出し側で保持)
+// 戻値: 0=登録完了 TINYI2C_BUSY=このバスで別の転送を進めている
+// 備考: バスには何もしない 実際の転送は TinyI2C_poll() を呼ぶたびに進む
 //========================================================================
-uint8_t TinyI2C_setRegBit( uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t set_bit )
+uint8_t TinyI2C_begin( TINYI2C_BUS *bus, TINYI2C_JOB *job )
 {
-    uint8_t data[2];
-    uint8_t status;
-
-    data[0] = mem_addr;
-    status = TinyI2C_readReg( slave_7bit_addr, data[0], &data[1] );
-    if(status != TINYI2C_NO_ERROR)
+    if (bus->poll_job != NULL)
     {
-        return status;
+        return TINYI2C_BUSY;
     }
 
-    data[1] |= set_bit;
+    job->status = TINYI2C_BUSY;
+    bus->poll_job = job;
+    bus->poll_phase = POLL_START;
+    bus->poll_attempt = 0;
+    bus->poll_spent = 0;
+    bus->poll_wait = 0;
 
-    return TinyI2C_write_data( slave_7bit_addr, data, 2, SEND_STOP );
+    return TINYI2C_NO_ERROR;
 }
 
 //========================================================================
-//  特定ビットクリア
+//  ポーリング転送の開始を遅らせる
 //------------------------------------------------------------------------
-// 引数: uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
-//       uint8_t mem_addr        : レジスタのメモリアドレス
-//       uint8_t clear_bit       : クリアするビットの位置
-// 戻値: 0=正常終了 それ以外I2C通信エラー
+// 引数: TINYI2C_BUS *bus : バス
+//       uint16_t us      : 次のフェーズを進めるまでの時間(us)
+// 戻値: なし
+// 備考: TinyI2C_begin() の直後に呼ぶと、スタートコンディションを us だけ
+//       後にする(スレーブの処理待ちなど) 待つ間も TinyI2C_poll() は戻る
+//========================================================================
+void TinyI2C_poll_delay( TINYI2C_BUS *bus, uint16_t us )
+{
+    bus->poll_wait = us;
+#ifdef TINYI2C_CLOCK_US
+    bus->poll_t0 = (uint16_t)TINYI2C_CLOCK_US();
+#endif
+}
+
+//========================================================================
+//  ポーリング転送を1フェーズ進める
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: TINYI2C_BUSY=転送中(また呼ぶこと) それ以外=完了(job->status と同じ)
+//       転送がなければ 0
+// 備考: 1回の呼び出しはスタート/STOPか1バイト(+ACK)分だけバスを動かす
+//       (100kHzで最長約90us、クロックストレッチ中はその分延びる)
+//       リトライのバックオフ中は何もせずに TINYI2C_BUSY を返す
+//       (TINYI2C_CLOCK_US が無ければ1回に TINYI2C_POLL_SLICE_US までずつ待つ)
 //========================================================================
-uint8_t TinyI2C_clearRegBit( uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t clear_bit )
+uint8_t TinyI2C_poll( TINYI2C_BUS *bus )
 {
-    uint8_t data[2];
+    TINYI2C_JOB *job;
     uint8_t status;
+    uint16_t wait;
 
-    data[0] = mem_addr;
-    status = TinyI2C_readReg( slave_7bit_addr, data[0], &data[1] );
-    if(status != TINYI2C_NO_ERROR)
+    job = bus->poll_job;
+    if (job == NULL)
     {
-        return status;
+        return TINYI2C_NO_ERROR;
+    }
+
+    if (TinyI2C_poll_waiting(bus))
+    {
+        return TINYI2C_BUSY;
+    }
+
+    status = TinyI2C_poll_step(bus, job);
+    if (status == TINYI2C_BUSY)
+    {
+        return TINYI2C_BUSY;
     }
 
-    data[1] &= ~clear_bit;
+    if (TinyI2C_retry_next(bus, status, bus->poll_attempt, &bus->poll_spent, &wait))
+    {
+        TinyI2C_clearStatus(bus);               //異常フラグをクリアしてやり直し
+        TinyI2C_poll_delay(bus, wait);
+        bus->poll_attempt++;
+        bus->poll_phase = POLL_START;
+        return TINYI2C_BUSY;
+    }
+
+    bus->poll_job = NULL;
+    job->status = status;
+    if (job->callback != NULL)
+    {
+        job->callback(job);
+    }
 
-    return TinyI2C_write_data( slave_7bit_addr, data, 2, SEND_STOP );
+    return status;
 }
 
+//========================================================================
+//  ポーリング転送のバックオフ中か
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 非0=まだ待つ 0=待ち終わった(または待っていない)
+// 備考: 待ち終わったら poll_wait を0に戻すので、時刻の比較は待っている間だけ
+//       (TINYI2C_CLOCK_US は約65msで1周するので、それより間を空けずに呼ぶこと)
+//========================================================================
+static uint8_t TinyI2C_poll_waiting( TINYI2C_BUS *bus )
+{
+#ifndef TINYI2C_CLOCK_US
+    uint16_t slice;
+#endif
+
+    if (bus->poll_wait == 0)
+    {
+        return 0;
+    }
+
+#ifdef TINYI2C_CLOCK_US
+    if ((uint16_t)((uint16_t)TINYI2C_CLOCK_US() - bus->poll_t0) < bus->poll_wait)
+    {
+        return 1;
+    }
+    bus->poll_wait = 0;
+#else
+    // 時計が無いので、バスを開放したまま少しずつ待つ
+    slice = (bus->poll_wait < TINYI2C_POLL_SLICE_US) ? bus->poll_wait : TINYI2C_POLL_SLICE_US;
+    bus->ops->idle(bus, slice);
+    bus->poll_wait -= slice;
+    if (bus->poll_wait != 0)
+    {
+        return 1;
+    }
+#endif
+
+    return 0;
+}
+
+//========================================================================
+//  ポーリング転送の1フェーズ
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       TINYI2C_JOB *job : 転送記述子
+// 戻値: TINYI2C_BUSY=続きあり それ以外=このトランザクションの結果
+//========================================================================
+static uint8_t TinyI2C_poll_step( TINYI2C_BUS *bus, TINYI2C_JOB *job )
+{
+    uint8_t status;
+    uint8_t data;
+
+    status = TINYI2C_NO_ERROR;
+    switch (bus->poll_phase)
+    {
+    case POLL_START:
+        status = TinyI2C_start(bus);
+        bus->poll_index = 0;
+        bus->poll_phase = (job->wsize == 0 && job->rsize != 0) ? POLL_RADDR : POLL_WADDR;
+        break;
+
+    case POLL_WADDR:
+        status = TinyI2C_write(bus, (job->slave_7bit_addr<<1) | 0x00);
+        bus->poll_phase = POLL_TX;
+        break;
+
+    case POLL_TX:
+        if (bus->poll_index < job->wsize)
+        {
+#ifdef USE_STREAM_TRANSFER
+            if (job->produce != NULL)
+            {
+                data = job->produce(job->ctx, bus->poll_index);
+            }
+            else
+#endif
+            {
+                data = job->wdata[bus->poll_index];
+            }
+            bus->poll_index++;
+            status = TinyI2C_write(bus, data);
+        }
+        else if (job->rsize != 0)
+        {
+            // リピートスタートで読み込みへ
+            status = TinyI2C_start(bus);
+            bus->poll_index = 0;
+            bus->poll_phase = POLL_RADDR;
+        }
+        else
+        {
+            bus->poll_phase = POLL_STOP;
+        }
+        break;
+
+    case POLL_RADDR:
+        status = TinyI2C_write(bus, (job->slave_7bit_addr<<1) | 0x01);
+        bus->poll_phase = POLL_RX;
+        break;
+
+    case POLL_RX:
+        data = TinyI2C_read(bus, (bus->poll_index + 1 < job->rsize) ? MORE_READ : NO_MORE_READ);
+#ifdef USE_STREAM_TRANSFER
+        if (job->consume != NULL)
+        {
+            job->consume(job->ctx, bus->poll_index, data);
+        }
+        else
+#endif
+        {
+            job->rdata[bus->poll_index] = data;
+        }
+        bus->poll_index++;
+        status = TinyI2C_getStatus(bus);
+        if (bus->poll_index >= job->rsize)
+        {
+            bus->poll_phase = POLL_STOP;
+        }
+        break;
+
+    default:    // POLL_STOP
+        return TinyI2C_finish(bus, TINYI2C_NO_ERROR, SEND_STOP);
+    }
+
+    if (status != TINYI2C_NO_ERROR)
+    {
+        // 失敗したらその場でバスを開放して終わる
+        return TinyI2C_finish(bus, status, SEND_STOP);
+    }
+
+    return TINYI2C_BUSY;
+}
+#endif  /* USE_POLLED_TRANSFER */
+
+#ifdef USE_READ_WRITE_REGISTER
+//========================================================================
+//  レジスタ読み込み
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint8_t mem_addr        : レジスタのメモリアドレス
+//       uint8_t* data           : 読み込むデータ
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+//========================================================================
+uint8_t TinyI2C_readReg( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t *data )
+{
+    return TinyI2C_readRegs(bus, slave_7bit_addr, mem_addr, TINYI2C_REG8, data, 1);
+}
+
+//========================================================================
+//  レジスタ連続読み込み(デバイスのアドレス自動インクリメントを利用)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint16_t mem_addr       : 先頭レジスタのメモリアドレス
+//       uint8_t addr_width      : アドレス幅 TINYI2C_REG8 / TINYI2C_REG16
+//       uint8_t* data           : 読み込むデータ
+//       uint8_t size            : 読み込むデータサイズ
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+//========================================================================
+uint8_t TinyI2C_readRegs( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint16_t mem_addr, uint8_t addr_width, uint8_t *data, uint8_t size )
+{
+    uint8_t addr[2];
+    TINYI2C_MSG msgs[2];
+
+    // アドレスは上位バイトから送信
+    addr[0] = (addr_width == TINYI2C_REG16) ? (mem_addr >> 8) : mem_addr;
+    addr[1] = mem_addr;
+
+    msgs[0].slave_7bit_addr = slave_7bit_addr;
+    msgs[0].flags = TINYI2C_M_WR;
+    msgs[0].len = addr_width;
+    msgs[0].buf = addr;
+    msgs[1].slave_7bit_addr = slave_7bit_addr;
+    msgs[1].flags = TINYI2C_M_RD;
+    msgs[1].len = size;
+    msgs[1].buf = data;
+
+#ifdef USE_REGISTER_CACHE
+    {
+        uint8_t status;
+
+        status = TinyI2C_transfer_msgs(bus, msgs, 2);
+        if (status == TINYI2C_NO_ERROR && addr_width == TINYI2C_REG8)
+        {
+            TinyI2C_cache_store(bus, slave_7bit_addr, mem_addr, data, size);
+        }
+        return status;
+    }
+#else
+    return TinyI2C_transfer_msgs(bus, msgs, 2);
+#endif
+}
+
+//========================================================================
+//  レジスタ連続書き込み(デバイスのアドレス自動インクリメントを利用)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint16_t mem_addr       : 先頭レジスタのメモリアドレス
+//       uint8_t addr_width      : アドレス幅 TINYI2C_REG8 / TINYI2C_REG16
+//       const uint8_t* data     : 書き込むデータ
+//       uint8_t size            : 書き込むデータサイズ
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+//========================================================================
+uint8_t TinyI2C_writeRegs( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint16_t mem_addr, uint8_t addr_width, const uint8_t *data, uint8_t size )
+{
+    uint8_t addr[2];
+    TINYI2C_MSG msgs[2];
+
+    // アドレスは上位バイトから送信
+    addr[0] = (addr_width == TINYI2C_REG16) ? (mem_addr >> 8) : mem_addr;
+    addr[1] = mem_addr;
+
+    // アドレスとデータを1トランザクションで送る(データはコピーしない)
+    msgs[0].slave_7bit_addr = slave_7bit_addr;
+    msgs[0].flags = TINYI2C_M_WR;
+    msgs[0].len = addr_width;
+    msgs[0].buf = addr;
+    msgs[1].slave_7bit_addr = slave_7bit_addr;
+    msgs[1].flags = TINYI2C_M_WR | TINYI2C_M_NOSTART;
+    msgs[1].len = size;
+    msgs[1].buf = (uint8_t *)data;
+
+#ifdef USE_REGISTER_CACHE
+    {
+        uint8_t status;
+
+        status = TinyI2C_transfer_msgs(bus, msgs, 2);
+        if (addr_width == TINYI2C_REG8)
+        {
+            // 失敗したときはどこまで書けたか不明なので範囲を無効化する
+            TinyI2C_cache_store(bus, slave_7bit_addr, mem_addr, (status == TINYI2C_NO_ERROR) ? data : NULL, size);
+        }
+        return status;
+    }
+#else
+    return TinyI2C_transfer_msgs(bus, msgs, 2);
+#endif
+}
+
+//========================================================================
+//  レジスタ連続書き込み(データはプログラムメモリから)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus           : バス
+//       uint8_t slave_7bit_addr     : ターゲットの7ビットアドレス
+//       uint16_t mem_addr           : 先頭レジスタのメモリアドレス
+//       uint8_t addr_width          : アドレス幅 TINYI2C_REG8 / TINYI2C_REG16
+//       const uint8_t *progmem_data : 書き込むデータ(PROGMEM)
+//       uint8_t size                : 書き込むデータサイズ
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+//========================================================================
+uint8_t TinyI2C_writeRegs_P( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint16_t mem_addr, uint8_t addr_width, const uint8_t *progmem_data, uint8_t size )
+{
+    uint8_t addr[2];
+    uint8_t status;
+
+    // アドレスは上位バイトから送信
+    if (addr_width == TINYI2C_REG16)
+    {
+        addr[0] = mem_addr >> 8;
+        addr[1] = mem_addr;
+    }
+    else
+    {
+        addr[0] = mem_addr;
+    }
+
+    status = TinyI2C_write_flash(bus, slave_7bit_addr, addr, addr_width, progmem_data, size, SEND_STOP);
+#ifdef USE_REGISTER_CACHE
+    if (addr_width == TINYI2C_REG8)
+    {
+        // 値はフラッシュにあるので範囲を無効化し、次の読み込みで取り直す
+        TinyI2C_cache_store(bus, slave_7bit_addr, mem_addr, NULL, size);
+    }
+#endif
+    return status;
+}
+
+//========================================================================
+//  レジスタマスク書き込み
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint8_t mem_addr        : レジスタのメモリアドレス
+//       uint8_t mask            : 設定するビットのマスクデータ
+//       uint8_t set_bit         : 設定データ
+// 戻値: 0=正常終了 それ以外I2C通信エラー
+//========================================================================
+uint8_t TinyI2C_masksetRegBit( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t mask, uint8_t set_bit )
+{
+    uint8_t data;
+    uint8_t status;
+#ifdef USE_REGISTER_CACHE
+    TINYI2C_REGCACHE *cache;
+    uint8_t idx, vmask;
+
+    cache = TinyI2C_cache_find(bus, slave_7bit_addr, mem_addr);
+    if (cache != NULL)
+    {
+        idx = mem_addr - cache->first_reg;
+        vmask = pgm_read_byte(&cache->volatile_mask[idx]);
+        if (cache->valid & (1U << idx))
+        {
+            // 読み込みを省略 触らない揮発ビットは1を書いて保持させる
+            data = cache->value[idx] | vmask;
+            data &= ~mask;
+            data |= set_bit;
+            return TinyI2C_writeRegs(bus, slave_7bit_addr, mem_addr, TINYI2C_REG8, &data, 1);
+        }
+    }
+#endif
+
+    status = TinyI2C_readReg(bus, slave_7bit_addr, mem_addr, &data );
+    if(status != TINYI2C_NO_ERROR)
+    {
+        return status;
+    }
+    data &= ~mask;
+    data |= set_bit;
+
+    return TinyI2C_writeRegs(bus, slave_7bit_addr, mem_addr, TINYI2C_REG8, &data, 1);
+}
+
+//========================================================================
+//  特定ビット設定
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint8_t mem_addr        : レジスタのメモリアドレス
+//       uint8_t set_bit         : 設定するビットの位置
+// 戻値: 0=正常終了 それ以外I2C通信エラー
+//========================================================================
+uint8_t TinyI2C_setRegBit( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t set_bit )
+{
+    return TinyI2C_masksetRegBit( bus, slave_7bit_addr, mem_addr, set_bit, set_bit );
+}
+
+//========================================================================
+//  特定ビットクリア
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint8_t mem_addr        : レジスタのメモリアドレス
+//       uint8_t clear_bit       : クリアするビットの位置
+// 戻値: 0=正常終了 それ以外I2C通信エラー
+//========================================================================
+uint8_t TinyI2C_clearRegBit( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t clear_bit )
+{
+    return TinyI2C_masksetRegBit( bus, slave_7bit_addr, mem_addr, clear_bit, 0x00 );
+}
+
+
+#ifdef USE_REGISTER_BATCH
+//========================================================================
+//  ビット操作バッチの初期化
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BATCH *batch     : バッチ(呼び出し側で確保)
+//       TINYI2C_BUS *bus         : ターゲットのバス
+//       uint8_t slave_7bit_addr  : ターゲットの7ビットアドレス
+// 戻値: なし
+//========================================================================
+void TinyI2C_batch_init( TINYI2C_BATCH *batch, TINYI2C_BUS *bus, uint8_t slave_7bit_addr )
+{
+    batch->bus = bus;
+    batch->slave_7bit_addr = slave_7bit_addr;
+    batch->n = 0;
+}
+
+//========================================================================
+//  ビット操作バッチにマスク書き込みを追加
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BATCH *batch : バッチ
+//       uint8_t mem_addr     : レジスタのメモリアドレス
+//       uint8_t mask         : 設定するビットのマスクデータ
+//       uint8_t set_bit      : 設定データ
+// 戻値: 0=正常終了 TINYI2C_QUEUE_FULL=バッチが満杯
+// 備考: TinyI2C_batch_setRegBit() / TinyI2C_batch_clearRegBit() も同じ
+//========================================================================
+uint8_t TinyI2C_batch_masksetRegBit( TINYI2C_BATCH *batch, uint8_t mem_addr, uint8_t mask, uint8_t set_bit )
+{
+    TINYI2C_EDIT *e;
+
+    if (batch->n >= TINYI2C_BATCH_MAX)
+    {
+        return TINYI2C_QUEUE_FULL;
+    }
+
+    e = &batch->edit[batch->n++];
+    e->reg = mem_addr;
+    e->mask = mask;
+    e->set_bit = set_bit;
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  ビット操作バッチの実行
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BATCH *batch : バッチ
+// 戻値: 0=正常終了 それ以外I2C通信エラー
+// 備考: 対象レジスタを含む範囲を1回で読み込み、追加した順に編集を適用して
+//       編集したレジスタの連続区間ごとに、最初に編集した順で書き戻す
+//       (編集していないレジスタは書き込まない) 結果は1つずつ呼んだ場合と同じ
+//       範囲が TINYI2C_BATCH_SPAN を超えるときは1つずつ実行する
+//========================================================================
+uint8_t TinyI2C_batch_commit( TINYI2C_BATCH *batch )
+{
+    uint8_t buf[TINYI2C_BATCH_SPAN];
+    uint16_t touched;
+    uint8_t lo, hi, i, first, run, status;
+    TINYI2C_EDIT *e;
+
+    if (batch->n == 0)
+    {
+        return TINYI2C_NO_ERROR;
+    }
+
+    lo = hi = batch->edit[0].reg;
+    for (i = 1; i < batch->n; i++)
+    {
+        if (batch->edit[i].reg < lo)
+        {
+            lo = batch->edit[i].reg;
+        }
+        if (batch->edit[i].reg > hi)
+        {
+            hi = batch->edit[i].reg;
+        }
+    }
+
+    if (hi - lo >= TINYI2C_BATCH_SPAN)
+    {
+        // 範囲が広すぎるときは1つずつ
+        for (i = 0, e = batch->edit; i < batch->n; i++, e++)
+        {
+            status = TinyI2C_masksetRegBit(batch->bus, batch->slave_7bit_addr, e->reg, e->mask, e->set_bit);
+            if (status != TINYI2C_NO_ERROR)
+            {
+                return status;
+            }
+        }
+        batch->n = 0;
+        return TINYI2C_NO_ERROR;
+    }
+
+    touched = 0;
+    for (i = 0; i < batch->n; i++)
+    {
+        touched |= 1U << (batch->edit[i].reg - lo);
+    }
+
+#ifdef USE_REGISTER_CACHE
+    // 全対象レジスタがキャッシュにあれば読み込みを省略
+    {
+        TINYI2C_REGCACHE *cache;
+        uint8_t idx;
+
+        status = TINYI2C_NO_ERROR;
+        for (i = 0; i <= hi - lo; i++)
+        {
+            if (!(touched & (1U << i)))
+            {
+                continue;
+            }
+            cache = TinyI2C_cache_find(batch->bus, batch->slave_7bit_addr, lo + i);
+            idx = lo + i - (cache ? cache->first_reg : 0);
+            if (cache == NULL || !(cache->valid & (1U << idx)))
+            {
+                status = TINYI2C_BUSY;          //キャッシュにない
+                break;
+            }
+            buf[i] = cache->value[idx] | pgm_read_byte(&cache->volatile_mask[idx]);
+        }
+        if (status != TINYI2C_NO_ERROR)
+        {
+            status = TinyI2C_readRegs(batch->bus, batch->slave_7bit_addr, lo, TINYI2C_REG8, buf, hi - lo + 1);
+        }
+    }
+#else
+    status = TinyI2C_readRegs(batch->bus, batch->slave_7bit_addr, lo, TINYI2C_REG8, buf, hi - lo + 1);
+#endif
+    if (status != TINYI2C_NO_ERROR)
+    {
+        return status;
+    }
+
+    // 追加した順に適用
+    for (i = 0, e = batch->edit; i < batch->n; i++, e++)
+    {
+        buf[e->reg - lo] &= ~e->mask;
+        buf[e->reg - lo] |= e->set_bit;
+    }
+
+    // 編集したレジスタの連続区間ごとに、最初に編集した順で書き戻し
+    for (e = batch->edit; touched != 0; e++)
+    {
+        first = e->reg - lo;
+        if (!(touched & (1U << first)))
+        {
+            continue;                           //書き戻し済み
+        }
+        while (first > 0 && (touched & (1U << (first - 1))))
+        {
+            first--;
+        }
+        for (run = 0; first + run <= hi - lo && (touched & (1U << (first + run))); run++)
+        {
+            touched &= ~(1U << (first + run));
+        }
+        status = TinyI2C_writeRegs(batch->bus, batch->slave_7bit_addr, lo + first, TINYI2C_REG8, &buf[first], run);
+        if (status != TINYI2C_NO_ERROR)
+        {
+            return status;
+        }
+    }
+
+    batch->n = 0;
+    return TINYI2C_NO_ERROR;
+}
+#endif  /* USE_REGISTER_BATCH */
+
+#ifdef USE_REGISTER_CACHE
+//========================================================================
+//  レジスタキャッシュの登録
+//------------------------------------------------------------------------
+// 引数: TINYI2C_REGCACHE *cache     : キャッシュ(呼び出し側で確保)
+//       TINYI2C_BUS *bus            : ターゲットのバス
+//       uint8_t slave_7bit_addr     : ターゲットの7ビットアドレス
+//       uint8_t first_reg           : キャッシュする先頭レジスタ
+//       uint8_t count               : レジスタ数(TINYI2C_CACHE_REGS以下)
+//       const uint8_t *volatile_mask: レジスタごとの揮発ビット(PROGMEM)
+//                                     0xFFのレジスタはキャッシュしない
+// 戻値: なし
+// 備考: 揮発ビットはデバイスが変化させるビット(フラグ等)で、0書き込みで
+//       クリア・1書き込みで保持されるものとして扱う
+//========================================================================
+void TinyI2C_cache_attach( TINYI2C_REGCACHE *cache, TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t first_reg, uint8_t count, const uint8_t *volatile_mask )
+{
+    TINYI2C_REGCACHE *p;
+
+    cache->bus = bus;
+    cache->slave_7bit_addr = slave_7bit_addr;
+    cache->first_reg = first_reg;
+    cache->count = (count > TINYI2C_CACHE_REGS) ? TINYI2C_CACHE_REGS : count;
+    cache->volatile_mask = volatile_mask;
+    cache->valid = 0;
+
+    for (p = cache_list; p != NULL; p = p->next)
+    {
+        if (p == cache)
+        {
+            return;                             //登録済み
+        }
+    }
+    cache->next = cache_list;
+    cache_list = cache;
+}
+
+//========================================================================
+//  レジスタキャッシュの無効化
+//------------------------------------------------------------------------
+// 引数: TINYI2C_REGCACHE *cache : キャッシュ
+// 戻値: なし
+// 備考: TinyI2C_write_data(bus, )などで直接書き込んだあとに呼ぶこと
+//========================================================================
+void TinyI2C_cache_invalidate( TINYI2C_REGCACHE *cache )
+{
+    cache->valid = 0;
+}
+
+//========================================================================
+//  レジスタキャッシュの1レジスタ無効化
+//------------------------------------------------------------------------
+// 引数: TINYI2C_REGCACHE *cache : キャッシュ
+//       uint8_t reg             : 無効化するレジスタ
+// 戻値: なし
+//========================================================================
+void TinyI2C_cache_invalidateReg( TINYI2C_REGCACHE *cache, uint8_t reg )
+{
+    if ((uint8_t)(reg - cache->first_reg) < cache->count)
+    {
+        cache->valid &= ~(1U << (reg - cache->first_reg));
+    }
+}
+
+//========================================================================
+//  レジスタを含むキャッシュを探す
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint8_t reg             : レジスタ
+// 戻値: キャッシュ なければNULL
+//========================================================================
+static TINYI2C_REGCACHE *TinyI2C_cache_find( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t reg )
+{
+    TINYI2C_REGCACHE *p;
+
+    for (p = cache_list; p != NULL; p = p->next)
+    {
+        if (p->bus == bus && p->slave_7bit_addr == slave_7bit_addr && (uint8_t)(reg - p->first_reg) < p->count)
+        {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+//========================================================================
+//  読み書きしたレジスタ値をキャッシュに反映
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint8_t reg             : 先頭レジスタ
+//       const uint8_t *data     : レジスタ値 NULLなら無効化
+//       uint8_t size            : レジスタ数
+// 戻値: なし
+//========================================================================
+static void TinyI2C_cache_store( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t reg, const uint8_t *data, uint8_t size )
+{
+    TINYI2C_REGCACHE *cache;
+    uint8_t idx, vmask;
+
+    for (; size > 0; --size, reg++)
+    {
+        cache = TinyI2C_cache_find(bus, slave_7bit_addr, reg);
+        if (cache != NULL)
+        {
+            idx = reg - cache->first_reg;
+            vmask = pgm_read_byte(&cache->volatile_mask[idx]);
+            if (data == NULL || vmask == 0xFF)
+            {
+                cache->valid &= ~(1U << idx);
+            }
+            else
+            {
+                cache->value[idx] = *data & ~vmask;
+                cache->valid |= (1U << idx);
+            }
+        }
+        if (data != NULL)
+        {
+            data++;
+        }
+    }
+}
+#endif  /* USE_REGISTER_CACHE */
+
+#endif  /* USE_READ_WRITE_REGISTER */
+
+#ifdef USE_SMBUS
+//========================================================================
+//  SMBusのコマンド書き込み(Send Byte / Write Byte / Write Word / Block Write)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint8_t cmd             : コマンドコード
+//       const uint8_t *data     : 書き込むデータ(ワードは下位バイトから)
+//       uint8_t size            : データサイズ 0ならSend Byte
+//       uint8_t flags           : TINYI2C_SMBUS_PEC / TINYI2C_SMBUS_BLOCK の和
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+// 備考: TINYI2C_SMBUS_BLOCK ならコマンドの次にバイト数を送る
+//       TINYI2C_SMBUS_PEC なら最後にPECを送る
+//========================================================================
+uint8_t TinyI2C_smbus_write( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t cmd, const uint8_t *data, uint8_t size, uint8_t flags )
+{
+    if ((flags & TINYI2C_SMBUS_BLOCK) && size > TINYI2C_SMBUS_BLOCK_MAX)
+    {
+        return TINYI2C_BLOCK_SIZE_ERROR;
+    }
+
+    return TinyI2C_smbus_xfer(bus, slave_7bit_addr, cmd, (uint8_t *)data, size, NULL, flags);
+}
+
+//========================================================================
+//  SMBusのコマンド読み込み(Read Byte / Read Word)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint8_t cmd             : コマンドコード
+//       uint8_t *data           : 読み込むデータ(ワードは下位バイトから)
+//       uint8_t size            : データサイズ
+//       uint8_t flags           : TINYI2C_SMBUS_PEC ならPECを読んで検査する
+// 戻値: 0=正常終了　TINYI2C_PEC_ERROR=PEC不一致　それ以外I2C通信エラー
+//========================================================================
+uint8_t TinyI2C_smbus_read( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t cmd, uint8_t *data, uint8_t size, uint8_t flags )
+{
+    return TinyI2C_smbus_xfer(bus, slave_7bit_addr, cmd, data, size, &size, flags & ~TINYI2C_SMBUS_BLOCK);
+}
+
+//========================================================================
+//  SMBusのブロック読み込み(Block Read)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint8_t cmd             : コマンドコード
+//       uint8_t *data           : 読み込むデータ
+//       uint8_t *size           : 入力=dataの大きさ 出力=スレーブが返したバイト数
+//       uint8_t flags           : TINYI2C_SMBUS_PEC ならPECを読んで検査する
+// 戻値: 0=正常終了　TINYI2C_PEC_ERROR=PEC不一致
+//       TINYI2C_BLOCK_SIZE_ERROR=バイト数が0かdataに入らない　それ以外I2C通信エラー
+//========================================================================
+uint8_t TinyI2C_smbus_blockRead( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t cmd, uint8_t *data, uint8_t *size, uint8_t flags )
+{
+    return TinyI2C_smbus_xfer(bus, slave_7bit_addr, cmd, data, *size, size, flags | TINYI2C_SMBUS_BLOCK);
+}
+
+//========================================================================
+//  SMBusのトランザクション
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint8_t cmd             : コマンドコード
+//       uint8_t *buf            : 書き込むデータ/読み込むデータ
+//       uint8_t size            : データサイズ(ブロック読み込みは上限)
+//       uint8_t *count          : NULLなら書き込み それ以外は読み込みで、読んだバイト数を返す
+//       uint8_t flags           : TINYI2C_SMBUS_PEC / TINYI2C_SMBUS_BLOCK の和
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+// 備考: CRC-8は送受信したバイトごとにループの中で計算し、バッファを読み直さない
+//       PEC不一致もバスのリトライ方針に従ってやり直す
+//========================================================================
+static uint8_t TinyI2C_smbus_xfer( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t cmd, uint8_t *buf, uint8_t size, uint8_t *count, uint8_t flags )
+{
+    uint8_t i;
+    uint8_t status;
+    uint8_t crc;
+    uint8_t data;
+    uint8_t n, k;
+    uint8_t *p;
+    uint16_t spent;
+
+    STATS_BEGIN();
+    for (i = 0, spent = 0; ; i++)
+    {
+        crc = 0;
+        n = size;
+
+        // スタートコンディション発行
+        status = TinyI2C_start(bus);
+        if (status == TINYI2C_NO_ERROR)
+        {
+            // マスターの送信宣言
+            data = (slave_7bit_addr<<1) | 0x00;
+            status = TinyI2C_write(bus, data);
+            crc = SMBUS_CRC8(crc, data);
+            STATS_OUT();
+        }
+        if (status == TINYI2C_NO_ERROR)
+        {
+            status = TinyI2C_write(bus, cmd);
+            crc = SMBUS_CRC8(crc, cmd);
+            STATS_OUT();
+        }
+
+        if (count == NULL)
+        {
+            if (status == TINYI2C_NO_ERROR && (flags & TINYI2C_SMBUS_BLOCK))
+            {
+                status = TinyI2C_write(bus, n);
+                crc = SMBUS_CRC8(crc, n);
+                STATS_OUT();
+            }
+            for (k = 0; k < n && status == TINYI2C_NO_ERROR; k++)
+            {
+                data = buf[k];
+                status = TinyI2C_write(bus, data);
+                crc = SMBUS_CRC8(crc, data);
+                STATS_OUT();
+            }
+            if (status == TINYI2C_NO_ERROR && (flags & TINYI2C_SMBUS_PEC))
+            {
+                status = TinyI2C_write(bus, crc);
+                STATS_OUT();
+            }
+        }
+        else
+        {
+            if (status == TINYI2C_NO_ERROR)
+            {
+                // リピートスタートで受信宣言
+                status = TinyI2C_start(bus);
+            }
+            if (status == TINYI2C_NO_ERROR)
+            {
+                data = (slave_7bit_addr<<1) | 0x01;
+                status = TinyI2C_write(bus, data);
+                crc = SMBUS_CRC8(crc, data);
+                STATS_OUT();
+            }
+            if (status == TINYI2C_NO_ERROR && (flags & TINYI2C_SMBUS_BLOCK))
+            {
+                n = TinyI2C_read(bus, MORE_READ);
+                crc = SMBUS_CRC8(crc, n);
+                STATS_IN();
+                if (n == 0 || n > size)
+                {
+                    TinyI2C_read(bus, NO_MORE_READ);    //NACKで打ち切る
+                    status = TINYI2C_BLOCK_SIZE_ERROR;
+                }
+            }
+            if (status == TINYI2C_NO_ERROR)
+            {
+                for (p = buf, k = n; k > 0 && TinyI2C_getStatus(bus) == TINYI2C_NO_ERROR; --k)
+                {
+                    data = TinyI2C_read(bus, (k == 1 && !(flags & TINYI2C_SMBUS_PEC)) ? NO_MORE_READ : MORE_READ);
+                    crc = SMBUS_CRC8(crc, data);
+                    *p++ = data;
+                    STATS_IN();
+                }
+                if ((flags & TINYI2C_SMBUS_PEC) && TinyI2C_getStatus(bus) == TINYI2C_NO_ERROR)
+                {
+                    data = TinyI2C_read(bus, NO_MORE_READ);
+                    STATS_IN();
+                }
+                status = TinyI2C_getStatus(bus);
+                if (status == TINYI2C_NO_ERROR && (flags & TINYI2C_SMBUS_PEC) && data != crc)
+                {
+                    status = TINYI2C_PEC_ERROR;
+                }
+            }
+            *count = (status == TINYI2C_NO_ERROR) ? n : 0;
+        }
+
+        status = TinyI2C_finish(bus, status, SEND_STOP);
+        if (!TinyI2C_retry_wait(bus, status, i, &spent))
+        {
+            break;
+        }
+        STATS_RETRY();
+    }
+
+    STATS_END(slave_7bit_addr, status);
+    return status;
+}
+
+#ifdef USE_SMBUS_CRC_NIBBLE
+//========================================================================
+//  CRC-8 1バイト分の更新(4ビット表を2回引く)
+//------------------------------------------------------------------------
+// 引数: uint8_t crc : これまでのCRCと新しいバイトのXOR
+// 戻値: 更新後のCRC
+//========================================================================
+static uint8_t TinyI2C_crc8_nibble( uint8_t crc )
+{
+    crc = (uint8_t)(crc << 4) ^ pgm_read_byte(&smbus_crc8_table[crc >> 4]);
+    crc = (uint8_t)(crc << 4) ^ pgm_read_byte(&smbus_crc8_table[crc >> 4]);
+
+    return crc;
+}
+#endif
+#endif  /* USE_SMBUS */
+
+#ifdef USE_TINYI2C_STATS
+//========================================================================
+//  トランザクション1回分の統計を記録
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus       : バス
+//       uint8_t slave_7bit_addr : ターゲットの7ビットアドレス
+//       uint8_t status          : 最終結果
+//       uint16_t spent          : リトライのバックオフで待った時間の合計(us)
+// 戻値: なし
+// 備考: 表が埋まったら最後の枠を TINYI2C_STATS_ANY(その他)として使う
+//       処理時間は TINYI2C_CLOCK_US があれば実測、なければバイト数と
+//       速度プロファイル、クロックストレッチ時間、バックオフから見積もる
+//========================================================================
+static void TinyI2C_stats_record( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t status, uint16_t spent )
+{
+    TINYI2C_STATS *st;
+    TINYI2C_BUS *owner;
+    uint16_t stretch;
+    uint32_t us;
+    uint8_t i;
+
+    for (i = 0, st = stats_table; i < TINYI2C_STATS_SLOTS - 1; i++, st++)
+    {
+        if ((st->bus == bus && st->slave_7bit_addr == slave_7bit_addr) || st->transactions == 0)
+        {
+            break;
+        }
+    }
+    owner = bus;
+    if (st->transactions != 0 && (st->bus != bus || st->slave_7bit_addr != slave_7bit_addr))
+    {
+        owner = NULL;                           //最後の枠はその他
+        slave_7bit_addr = TINYI2C_STATS_ANY;
+    }
+    st->bus = owner;
+    st->slave_7bit_addr = slave_7bit_addr;
+
+    st->transactions++;
+    st->bytes_out += stats_out;
+    st->bytes_in  += stats_in;
+    st->retries   += stats_retries;
+    st->backoff_us += spent;
+    switch (status)
+    {
+    case TINYI2C_SLAVE_NACK:
+        st->nacks++;
+        break;
+    case TINYI2C_UNKNOWN_START:
+    case TINYI2C_UNKNOWN_STOP:
+    case TINYI2C_DATA_COLLISION:
+    case TINYI2C_ARBITRATION_LOST:
+    case TINYI2C_BUS_BUSY:
+        st->collisions++;
+        break;
+    case TINYI2C_MISS_START_COND:
+        st->miss_start++;
+        break;
+    case TINYI2C_MISS_STOP_COND:
+        st->miss_stop++;
+        break;
+    case TINYI2C_TIMEOUT:
+        st->timeouts++;
+        break;
+    default:
+        break;
+    }
+
+    // その他の枠でもストレッチはこのバスのものとして消費する(次の転送に持ち越さない)
+    stretch = bus->stretch;
+    bus->stretch = 0;
+    if (stretch > st->max_stretch_us)
+    {
+        st->max_stretch_us = stretch;
+    }
+
+#ifdef TINYI2C_CLOCK_US
+    us = (uint16_t)((uint16_t)TINYI2C_CLOCK_US() - stats_t0);
+#else
+    // 処理時間の見積もり: 1バイト9ビット + START/STOP + 最長ストレッチ + バックオフ
+    us = ((uint32_t)(stats_out + stats_in) * 9 + 2) * (T2_TWI_NS + T4_TWI_NS) / 1000 + stretch + spent;
+#endif
+    for (i = 0; i < TINYI2C_STATS_BUCKETS - 1 && us >= ((uint32_t)TINYI2C_STATS_BUCKET0_US << i); i++)
+        ;
+    st->latency[i]++;
+}
+
+//========================================================================
+//  統計のスナップショット取得
+//------------------------------------------------------------------------
+// 引数: TINYI2C_STATS *dst : 格納先(TINYI2C_STATS_SLOTS 個分)
+// 戻値: 使用中の枠の数
+//========================================================================
+uint8_t TinyI2C_stats_snapshot( TINYI2C_STATS *dst )
+{
+    uint8_t i, n;
+
+    for (i = 0, n = 0; i < TINYI2C_STATS_SLOTS; i++)
+    {
+        if (stats_table[i].transactions != 0)
+        {
+            dst[n++] = stats_table[i];
+        }
+    }
+
+    return n;
+}
+
+//========================================================================
+//  統計のクリア
+//------------------------------------------------------------------------
+// 引数: なし
+// 戻値: なし
+//========================================================================
+void TinyI2C_stats_reset( void )
+{
+    uint16_t i;
+    uint8_t *p;
+
+    p = (uint8_t *)stats_table;
+    for (i = 0; i < sizeof(stats_table); i++)
+    {
+        *p++ = 0;
+    }
+}
+#endif  /* USE_TINYI2C_STATS */
 
-#endif  /* USE_READ_WRITE_REGISTER */
 #endif  /* USE_READ_WRITE_REPEAT */
 
 /* =============================================[ここまでばんとのソース] */
@@ -13,6 +13,32 @@
 // ????/??/??   がた老さん  soft_I2C.c開発完了
 // 2013/04/10   ばんと      修正完了
 // 2013/04/26   ばんと      レジスタ操作関数追加&変更
+// 2026/10/17   ばんと      USI割り込みによる非同期転送追加
+// 2026/10/17   ばんと      F_CPUから求める通信速度プロファイル追加
+// 2026/10/17   ばんと      メッセージ配列による一括転送追加
+// 2026/10/17   ばんと      クロックストレッチ待ちのタイムアウトとバスクリア追加
+// 2026/10/17   ばんと      複数レジスタ連続読み書き(8/16ビットアドレス)追加
+// 2026/10/17   ばんと      レジスタ・シャドウキャッシュ追加
+// 2026/10/17   ばんと      ビット操作の一括適用(バッチ)追加
+// 2026/10/17   ばんと      バスのバックエンド(USI/GPIO/ホストシミュレータ)を選択式に
+// 2026/10/17   ばんと      バス統計(スレーブごとのカウンタ)追加
+// 2026/10/17   ばんと      バスを引数で指定する形に変更(複数バス対応)
+// 2026/10/17   ばんと      1ポートに並べた最大8バスの同時転送追加
+// 2026/10/17   ばんと      リトライ方針(回数・バックオフ・対象ステータス)をバスごとに指定
+// 2026/10/17   ばんと      コールバックで1バイトずつ受け渡すストリーム転送追加
+// 2026/10/17   ばんと      プログラムメモリ(PROGMEM)から直接送る書き込み追加
+// 2026/10/17   ばんと      C++から使えるようにextern "C"追加(TinyI2CMaster.hpp)
+// 2026/10/17   ばんと      USIのビット送受信をアセンブラで行うオプション追加
+// 2026/10/17   ばんと      TinyI2C_poll()で少しずつ進めるノンブロッキング転送追加
+// 2026/10/17   ばんと      マルチマスター(アービトレーション負けとバス使用中の検出)対応
+// 2026/10/17   ばんと      SMBusのコマンド/ブロック転送とPEC(CRC-8)追加
+// 2026/10/17   ばんと      非同期転送のティックをF_CPUから決める(低いF_CPUで割り込みが追いつかない不具合修正)
+// 2026/10/17   ばんと      一括転送でNOSTARTの区間の向きを検査(不正な組み合わせはTINYI2C_BAD_MSG)
+// 2026/10/17   ばんと      統計にバックオフ時間を追加 処理時間分布はTINYI2C_CLOCK_USがあれば実測
+// 2026/10/17   ばんと      バス初期化子を指示付き初期化子に変更(-Wextraの警告対策)
+// 2026/10/17   ばんと      tLOW/tHIGHを速度ごとに引けるマクロにした(C++テンプレート版と共用)
+// 2026/10/17   ばんと      TinyI2C_poll()のバックオフを呼び出しをまたいで待つようにした(ブロックしない)
+// 2026/10/17   ばんと      マルチマスター: バスを持っているか(owned)を追加 リピートスタートで使用中と判定しない
 //------------------------------------------------------------------------
 // This code is distributed under Apache License 2.0 License
 //		which can be found at http://www.apache.org/licenses/
@@ -21,16 +47,83 @@
 #ifndef __TINYI2CMASTER_H_
 #define __TINYI2CMASTER_H_
 
+#include <stdint.h>
+#ifdef __AVR__
+#include <avr/io.h>
+#endif
+
 /* define --------------------------------------------------------------*/
+// 既定のバス TinyI2C_bus0 のバックエンド(コンパイル時に -DTINYI2C_BACKEND=... で選択)
+//   USI : TinyI2CMaster_USI.c   USI内蔵のATtiny/ATmega
+//   GPIO: TinyI2CMaster_GPIO.c  任意のピンでソフトウエアI2C(USIなしでも可)
+//   SIM : TinyI2CMaster_Sim.c   ホスト(Linux等)上のシミュレータ
+// TinyI2CMaster.c とドライバはどのバックエンドでも共通
+// バスを増やすときは TINYI2C_BUS_USI / TINYI2C_BUS_GPIO で TINYI2C_BUS を定義する
+// (SIMのときはどちらもシミュレータのバスになる)
+#define TINYI2C_BACKEND_USI		0
+#define TINYI2C_BACKEND_GPIO	1
+#define TINYI2C_BACKEND_SIM		2
+
+#ifndef TINYI2C_BACKEND
+#define TINYI2C_BACKEND	TINYI2C_BACKEND_USI
+#endif
+
 #define NOISE_TESTING
 #define SIGNAL_VERIFY
 #define USE_READ_WRITE_REPEAT
 #define USE_READ_WRITE_REGISTER
+#define USE_REGISTER_BATCH			// 複数のビット操作を1回の読み込み/書き込みにまとめる
+//#define USE_ASYNC_TRANSFER		// USIオーバーフロー割り込み＋Timer0による非同期転送
+//#define USE_REGISTER_CACHE		// レジスタ・シャドウキャッシュ(ビット操作の読み込みを省略)
+//#define USE_TINYI2C_STATS		// スレーブごとのバス統計(転送数、NACK、リトライ、処理時間分布)
+//#define USE_PARALLEL_BUS		// SCL共通・SDAを1ポートに並べた最大8バスの同時転送
+//#define USE_STREAM_TRANSFER		// バッファを使わず1バイトずつコールバックで受け渡す転送
+//#define USE_POLLED_TRANSFER		// TinyI2C_poll()で1フェーズずつ進めるノンブロッキング転送(割り込み不要)
+//#define USE_SMBUS				// SMBusのコマンド/ブロック転送とPEC
+//#define USE_SMBUS_CRC_NIBBLE	// PECのCRC-8を16バイトの表で計算(256バイトの表の代わり 小さいデバイス向け)
+//#define USE_MULTI_MASTER			// 他のマスターと共有するバス(アービトレーション負け/使用中を検出してリトライ)
+//#define USE_USI_ASM_KERNEL		// USIのビット送受信をサイクル数を数えたアセンブラで行う(低いF_CPUでも仕様上限のSCL)
  
-#define RETRY	3
+#define RETRY	3							// 既定のリトライ方針の試行回数(初回を含む)
+#define TINYI2C_RETRY_BACKOFF_US	50		// 既定のリトライ方針の最初の待ち(us)
+#define TINYI2C_RETRY_BUDGET_US		2000	// 既定のリトライ方針の待ち時間の合計上限(us)
+
+//#define TINYI2C_CLOCK_US()	my_micros()	// 自走するusカウンタ(下位16ビットを使う) あれば統計の処理時間を実測し、TinyI2C_poll()のバックオフを時刻で判定する
+#ifndef TINYI2C_POLL_SLICE_US
+#define TINYI2C_POLL_SLICE_US	100		// TINYI2C_CLOCK_US が無いとき TinyI2C_poll() 1回で待つバックオフの上限(us)
+#endif
+
+#ifndef TINYI2C_TIMEOUT_US
+#define TINYI2C_TIMEOUT_US	1000	// SCL High待ち(クロックストレッチ)の上限 初期値(us)
+#endif
+
+// 通信速度プロファイル(コンパイル時に -DTINYI2C_SPEED=... で選択)
+#define TINYI2C_SPEED_STANDARD		0		// 100kHz
+#define TINYI2C_SPEED_FAST			1		// 400kHz
+#define TINYI2C_SPEED_FAST_PLUS		2		// 1MHz
+
+#ifndef TINYI2C_SPEED
+#define TINYI2C_SPEED	TINYI2C_SPEED_STANDARD
+#endif
+
+// SCL Low/High 期間の最小値(ns) I2C仕様 tLOW/tHIGH より
+//   STANDARD  tLOW >4.7us  tHIGH >4.0us
+//   FAST      tLOW >1.3us  tHIGH >0.6us
+//   FAST_PLUS tLOW >0.5us  tHIGH >0.26us
+// (C++テンプレート版も速度ごとにこれを使う)
+#define TINYI2C_TLOW_NS(speed)	((speed) == TINYI2C_SPEED_STANDARD ? 4700 : (speed) == TINYI2C_SPEED_FAST ? 1300 : 500)
+#define TINYI2C_THIGH_NS(speed)	((speed) == TINYI2C_SPEED_STANDARD ? 4000 : (speed) == TINYI2C_SPEED_FAST ? 600 : 260)
+
+#if TINYI2C_SPEED > TINYI2C_SPEED_FAST_PLUS
+#error "unknown TINYI2C_SPEED"
+#endif
+#define T2_TWI_NS	TINYI2C_TLOW_NS(TINYI2C_SPEED)		// tLOW
+#define T4_TWI_NS	TINYI2C_THIGH_NS(TINYI2C_SPEED)		// tHIGH
 
-#define T2_TWI    5 		// >4,7us
-#define T4_TWI    4 		// >4,0us
+// ns → F_CPUのサイクル数(切り上げ)
+#define TWI_NS_TO_CYCLES(ns)	(((F_CPU / 1000UL) * (ns) + 999999UL) / 1000000UL)
+#define T2_TWI_CYCLES	TWI_NS_TO_CYCLES(T2_TWI_NS)
+#define T4_TWI_CYCLES	TWI_NS_TO_CYCLES(T4_TWI_NS)
 
 #define TINYI2C_NO_ERROR			0x00
 #define TINYI2C_UNKNOWN_START		0x01
@@ -39,10 +132,60 @@
 #define TINYI2C_MISS_START_COND		0x04
 #define TINYI2C_MISS_STOP_COND		0x05
 #define TINYI2C_SLAVE_NACK			0x06
+#define TINYI2C_BUSY				0x07	// 非同期転送: 処理待ち/処理中
+#define TINYI2C_QUEUE_FULL			0x08	// 非同期転送: キューが満杯
+#define TINYI2C_TIMEOUT				0x09	// SCLが解放されない/バスが復旧しない
+#define TINYI2C_ARBITRATION_LOST	0x0A	// マルチマスター: 送信中に他のマスターに負けた
+#define TINYI2C_BUS_BUSY			0x0B	// マルチマスター: 他のマスターが転送中
+#define TINYI2C_PEC_ERROR			0x0C	// SMBus: 受信したPECが一致しない
+#define TINYI2C_BLOCK_SIZE_ERROR	0x0D	// SMBus: ブロックのバイト数が0かバッファに入らない
+#define TINYI2C_BAD_MSG			0x0E	// 一括転送: NOSTARTの区間が先頭にあるか前の区間と向きが違う(ST7032iのバッチ: 長い命令の後に追加した)
 
 #define NO_SEND_STOP			0
 #define SEND_STOP				1
 
+#define NO_MORE_READ			0		// TinyI2C_read(): 最後のバイト(NACK送信)
+#define MORE_READ				1		// TinyI2C_read(): 続けて読む(ACK送信)
+
+#define TINYI2C_M_WR			0x00	// TINYI2C_MSG.flags: 書き込み
+#define TINYI2C_M_RD			0x01	// TINYI2C_MSG.flags: 読み込み
+#define TINYI2C_M_NOSTART		0x02	// TINYI2C_MSG.flags: 同じ向きの前の区間に続けて送る/読む
+
+#define TINYI2C_REG8			1		// レジスタアドレス幅 8ビット
+#define TINYI2C_REG16			2		// レジスタアドレス幅 16ビット(上位バイトから送信)
+
+#ifdef USE_REGISTER_BATCH
+#define TINYI2C_BATCH_MAX		8		// 1バッチの最大編集数
+#define TINYI2C_BATCH_SPAN		16		// 1回で読み込むレジスタ範囲の上限
+#endif
+
+#ifdef USE_REGISTER_CACHE
+#define TINYI2C_CACHE_REGS		16		// 1キャッシュあたりの最大レジスタ数
+#endif
+
+#ifdef USE_TINYI2C_STATS
+#define TINYI2C_STATS_SLOTS		4		// 統計を取るスレーブ数(最後の枠はその他)
+#define TINYI2C_STATS_BUCKETS	8		// 処理時間分布の段数
+#define TINYI2C_STATS_BUCKET0_US	64	// 最初の段の上限(us) 以降は2倍ずつ
+#define TINYI2C_STATS_ANY		0xFF	// その他のスレーブをまとめた枠のアドレス
+#endif
+
+#ifdef USE_SMBUS
+#define TINYI2C_SMBUS_BLOCK_MAX	32		// ブロック転送の最大バイト数
+#define TINYI2C_SMBUS_PEC		0x01	// TinyI2C_smbus_xxx() flags: PECを付ける/検査する
+#define TINYI2C_SMBUS_BLOCK		0x02	// TinyI2C_smbus_write() flags: バイト数を付ける(Block Write)
+#endif
+
+#ifdef USE_ASYNC_TRANSFER
+#define TINYI2C_QUEUE_SIZE		4		// 非同期転送キューの段数
+#define TINYI2C_ASYNC_TICK_CYCLES	80	// SCL半周期の最小サイクル数(Timer0割り込み1回の約2倍 残りをメインに回す)
+#ifndef TINYI2C_ASYNC_TICK_US
+// SCL半周期(us) 割り込み負荷を考えて同期版より遅め 低いF_CPUでは TINYI2C_ASYNC_TICK_CYCLES まで延ばす
+#define TINYI2C_ASYNC_TICK_US	(TINYI2C_ASYNC_TICK_CYCLES > 10 * (F_CPU / 1000000UL) ? \
+								 (TINYI2C_ASYNC_TICK_CYCLES + F_CPU / 1000000UL - 1) / (F_CPU / 1000000UL) : 10)
+#endif
+#endif
+
 
 // Device dependant defines ADDED BACK IN FROM ORIGINAL ATMEL .H
 
@@ -78,21 +221,339 @@
 #define PIN_USI_SCL         PINB7
 #endif
 
+// GPIOバックエンドのピン(未定義ならUSIのピンを使う)
+#if TINYI2C_BACKEND == TINYI2C_BACKEND_GPIO
+#ifndef TINYI2C_GPIO_SDA_DDR
+#ifndef DDR_USI
+#error "define TINYI2C_GPIO_SDA_DDR/PORT/PIN/BIT and TINYI2C_GPIO_SCL_DDR/PORT/PIN/BIT"
+#endif
+#define TINYI2C_GPIO_SDA_DDR	DDR_USI
+#define TINYI2C_GPIO_SDA_PORT	PORT_USI
+#define TINYI2C_GPIO_SDA_PIN	PIN_USI
+#define TINYI2C_GPIO_SDA_BIT	PIN_USI_SDA
+#define TINYI2C_GPIO_SCL_DDR	DDR_USI
+#define TINYI2C_GPIO_SCL_PORT	PORT_USI
+#define TINYI2C_GPIO_SCL_PIN	PIN_USI
+#define TINYI2C_GPIO_SCL_BIT	PIN_USI_SCL
+#endif
+#endif
+
+#if defined(USE_ASYNC_TRANSFER) && (TINYI2C_BACKEND == TINYI2C_BACKEND_SIM || !defined(DDR_USI))
+#error "USE_ASYNC_TRANSFER needs a USI bus"
+#endif
+#if defined(USE_MULTI_MASTER) && (defined(USE_ASYNC_TRANSFER) || defined(USE_USI_ASM_KERNEL))
+#error "USE_MULTI_MASTER checks arbitration bit by bit (not available with USE_ASYNC_TRANSFER / USE_USI_ASM_KERNEL)"
+#endif
+#if defined(USE_PARALLEL_BUS) && TINYI2C_BACKEND == TINYI2C_BACKEND_SIM
+#error "USE_PARALLEL_BUS needs GPIO ports (not available on SIM)"
+#endif
+
+// ホストでビルドするときの代用定義
+#ifndef __AVR__
+#ifndef _BV
+#define _BV(bit)			(1 << (bit))
+#endif
+#ifndef PROGMEM
+#define PROGMEM
+#define pgm_read_byte(addr)	(*(const uint8_t *)(addr))
+#endif
+#endif
+
 /* typedef -------------------------------------------------------------*/
+struct TINYI2C_BUS;
+
+// バックエンドの操作(TinyI2CMaster_USI.c / _GPIO.c / _Sim.c が1つずつ持つ)
+typedef struct TINYI2C_OPS
+{
+	void    (*init)( struct TINYI2C_BUS *bus );
+	uint8_t (*busClear)( struct TINYI2C_BUS *bus );
+	uint8_t (*start)( struct TINYI2C_BUS *bus );
+	uint8_t (*stop)( struct TINYI2C_BUS *bus );
+	uint8_t (*read)( struct TINYI2C_BUS *bus, uint8_t ack_nack );
+	uint8_t (*write)( struct TINYI2C_BUS *bus, uint8_t data );
+	void    (*clearStatus)( struct TINYI2C_BUS *bus );
+	void    (*idle)( struct TINYI2C_BUS *bus, uint16_t us );	// バスを開放したまま待つ
+} TINYI2C_OPS;
+
+// リトライ方針(複数のバス・ドライバで共有してよい)
+// 失敗したトランザクションは STOP(タイムアウトならバスクリア)のあと
+// backoff_us, 2*backoff_us, 4*backoff_us … 待ってから最初からやり直す
+typedef struct TINYI2C_RETRY
+{
+	uint8_t attempts;			// 最大試行回数(初回を含む) 1ならリトライしない
+	uint16_t backoff_us;		// 最初の待ち時間(us) 以降2倍ずつ
+	uint16_t budget_us;			// 1トランザクションで待つ時間の合計上限(us)
+	uint16_t retry_mask;		// リトライするステータス TINYI2C_RETRY_ON(TINYI2C_xxx)の和
+} TINYI2C_RETRY;
+
+// バス1本分の状態(TINYI2C_BUS_xxx で初期化し、TinyI2C_Master_init()に渡す)
+typedef struct TINYI2C_BUS
+{
+	const TINYI2C_OPS *ops;		// バックエンド
+	volatile uint8_t *sda_ddr;	// GPIOバックエンドのピン(USI/SIMでは未使用)
+	volatile uint8_t *sda_port;
+	volatile uint8_t *sda_pin;
+	volatile uint8_t *scl_ddr;
+	volatile uint8_t *scl_port;
+	volatile uint8_t *scl_pin;
+	uint8_t sda_mask;
+	uint8_t scl_mask;
+	uint16_t timeout;			// SCL High待ちの上限(us) 0ならTINYI2C_TIMEOUT_US
+	uint8_t error;				// 前回のスタート以降に起きたバスエラー
+	const struct TINYI2C_RETRY *retry;	// リトライ方針 NULLなら TinyI2C_retry_default
+#ifdef USE_TINYI2C_STATS
+	uint16_t stretch;			// 最長クロックストレッチ時間(us)
+#endif
+#ifdef USE_MULTI_MASTER
+	uint8_t owned;				// STARTを送ってまだSTOPを送っていない(次のSTARTはリピートスタート)
+	uint8_t foreign;			// GPIO: アービトレーションに負け、他のマスターのSTOPをまだ見ていない
+#endif
+#ifdef USE_POLLED_TRANSFER
+	struct TINYI2C_JOB *poll_job;	// TinyI2C_poll()で進めている転送 NULLならなし
+	uint16_t poll_index;		// 次に送受信するバイト
+	uint16_t poll_spent;		// リトライで待った時間の合計(us)
+	uint16_t poll_wait;			// 残りのバックオフ(us) 0なら待っていない TINYI2C_CLOCK_US があれば待つ長さ
+#ifdef TINYI2C_CLOCK_US
+	uint16_t poll_t0;			// バックオフを始めた時刻(us)
+#endif
+	uint8_t poll_phase;			// 次に行うフェーズ
+	uint8_t poll_attempt;		// 試行回数(0から)
+#endif
+} TINYI2C_BUS;
+
+// 一括転送の1区間(Linux の i2c_msg 相当) 区間の間はリピートスタートで連結
+typedef struct
+{
+	uint8_t slave_7bit_addr;	// ターゲットの7ビットアドレス
+	uint8_t flags;				// TINYI2C_M_WR / TINYI2C_M_RD
+	uint8_t len;				// データサイズ
+	uint8_t *buf;				// 送受信データ
+} TINYI2C_MSG;
+
+#ifdef USE_REGISTER_BATCH
+// ビット操作1件
+typedef struct
+{
+	uint8_t reg;				// レジスタのメモリアドレス
+	uint8_t mask;				// 設定するビットのマスクデータ
+	uint8_t set_bit;			// 設定データ
+} TINYI2C_EDIT;
+
+// ビット操作バッチ(TinyI2C_batch_commit()でまとめて実行)
+typedef struct
+{
+	TINYI2C_BUS *bus;			// ターゲットのバス
+	uint8_t slave_7bit_addr;	// ターゲットの7ビットアドレス
+	uint8_t n;					// 登録済みの編集数
+	TINYI2C_EDIT edit[TINYI2C_BATCH_MAX];
+} TINYI2C_BATCH;
+#endif
+
+#ifdef USE_REGISTER_CACHE
+// デバイスごとのレジスタ・シャドウキャッシュ(TinyI2C_cache_attach()で登録)
+typedef struct TINYI2C_REGCACHE
+{
+	struct TINYI2C_REGCACHE *next;
+	TINYI2C_BUS *bus;			// ターゲットのバス
+	uint8_t slave_7bit_addr;	// ターゲットの7ビットアドレス
+	uint8_t first_reg;			// 先頭レジスタ
+	uint8_t count;				// レジスタ数
+	uint16_t valid;				// レジスタごとの有効ビット
+	const uint8_t *volatile_mask;	// レジスタごとの揮発ビット(PROGMEM)
+	uint8_t value[TINYI2C_CACHE_REGS];	// シャドウ値(揮発ビットは0)
+} TINYI2C_REGCACHE;
+#endif
+
+#ifdef USE_TINYI2C_STATS
+// スレーブごとのバス統計(同期版のプロトコル層の転送のみ数える)
+typedef struct
+{
+	TINYI2C_BUS *bus;			// ターゲットのバス(その他の枠はNULL)
+	uint8_t slave_7bit_addr;	// ターゲットの7ビットアドレス(TINYI2C_STATS_ANY:その他)
+	uint16_t transactions;		// トランザクション数
+	uint32_t bytes_out;			// 送信バイト数(アドレスを含む)
+	uint32_t bytes_in;			// 受信バイト数
+	uint16_t nacks;				// NACKで終わった回数
+	uint16_t retries;			// リトライ回数
+	uint16_t collisions;		// 衝突(UNKNOWN_START/STOP, DATA_COLLISION, ARBITRATION_LOST, BUS_BUSY)で終わった回数
+	uint16_t miss_start;		// START条件失敗
+	uint16_t miss_stop;			// STOP条件失敗
+	uint16_t timeouts;			// クロックストレッチのタイムアウト
+	uint16_t max_stretch_us;	// 最長クロックストレッチ(us)
+	uint32_t backoff_us;		// リトライのバックオフで待った時間の合計(us)
+	// 処理時間分布 [0]:<64us [1]:<128us … [7]:それ以上
+	// TINYI2C_CLOCK_US があれば実測、なければ見積もり(バイト数×ビット時間+最長ストレッチ+バックオフ)
+	uint16_t latency[TINYI2C_STATS_BUCKETS];
+} TINYI2C_STATS;
+#endif
+
+#ifdef USE_STREAM_TRANSFER
+// ストリーム転送のコールバック index はトランザクション内の何バイト目か(0から)
+// リトライしたときは同じ index で再び呼ばれる
+typedef uint8_t (*TINYI2C_PRODUCER)( void *ctx, uint16_t index );				// 送信する1バイトを返す
+typedef void    (*TINYI2C_CONSUMER)( void *ctx, uint16_t index, uint8_t data );	// 受信した1バイトを受け取る
+#endif
+
+#if defined(USE_ASYNC_TRANSFER) || defined(USE_POLLED_TRANSFER)
+// 非同期/ポーリング転送の記述子(メモリは呼び出し側で確保し、完了まで保持すること)
+// wsize>0 なら書き込み、rsize>0 なら読み込み。両方ならリピートスタートで連結
+typedef struct TINYI2C_JOB
+{
+	uint8_t slave_7bit_addr;	// ターゲットの7ビットアドレス
+	uint8_t *wdata;				// 書き込むデータ
+	uint16_t wsize;				// 書き込むデータサイズ
+	uint8_t *rdata;				// 読み込むデータ
+	uint16_t rsize;				// 読み込むデータサイズ
+#ifdef USE_STREAM_TRANSFER
+	// NULLでなければ wdata / rdata の代わりに呼ばれる
+	// 非同期転送ではUSIが前のバイトをシフトしている間に割り込み内で呼ぶので、
+	// SCLの半周期より短く済ませること
+	TINYI2C_PRODUCER produce;
+	TINYI2C_CONSUMER consume;
+	void *ctx;					// コールバックに渡す値
+#endif
+	volatile uint8_t status;	// TINYI2C_BUSY → 完了時に結果が入る
+	void (*callback)( struct TINYI2C_JOB *job );	// 完了コールバック(非同期は割り込み内、ポーリングはTinyI2C_poll()内) NULL可
+} TINYI2C_JOB;
+#endif
+
+#ifdef USE_PARALLEL_BUS
+// 同時転送するバスの束(SDAは1つのポートに最大8本、SCLは全バス共通)
+// SDAのビット番号をレーンと呼ぶ 各レーンには同じアドレスのデバイスをつなぐ
+typedef struct
+{
+	volatile uint8_t *sda_ddr;	// SDAを並べたポート
+	volatile uint8_t *sda_port;
+	volatile uint8_t *sda_pin;
+	volatile uint8_t *scl_ddr;	// 共通のSCL
+	volatile uint8_t *scl_port;
+	volatile uint8_t *scl_pin;
+	uint8_t lanes;				// 使うレーン(SDAのビットマスク)
+	uint8_t scl_mask;
+	uint16_t timeout;			// SCL High待ちの上限(us) 0ならTINYI2C_TIMEOUT_US
+} TINYI2C_PBUS;
+#endif
+
 /* macro ---------------------------------------------------------------*/
+// バスの定義(指定しないメンバは0 -Wextra でも警告が出ないよう指示付き初期化子で書く)
+//   TINYI2C_BUS bus1 = TINYI2C_BUS_USI;
+//   TINYI2C_BUS bus2 = TINYI2C_BUS_GPIO(B, 3, B, 4);     // SDA=PB3 SCL=PB4
+#if TINYI2C_BACKEND == TINYI2C_BACKEND_SIM
+#define TINYI2C_BUS_SIM			{ .ops = &TinyI2C_sim_ops }
+#define TINYI2C_BUS_USI			TINYI2C_BUS_SIM
+#define TINYI2C_BUS_GPIO(sda_port, sda_bit, scl_port, scl_bit)	TINYI2C_BUS_SIM
+#else
+#define TINYI2C_BUS_USI			{ .ops = &TinyI2C_usi_ops }
+#define TINYI2C_BUS_GPIO_REGS(ddr_sda, port_sda, pin_sda, bit_sda, ddr_scl, port_scl, pin_scl, bit_scl) \
+	{ .ops = &TinyI2C_gpio_ops,																		\
+	  .sda_ddr = &(ddr_sda), .sda_port = &(port_sda), .sda_pin = &(pin_sda), .sda_mask = _BV(bit_sda),	\
+	  .scl_ddr = &(ddr_scl), .scl_port = &(port_scl), .scl_pin = &(pin_scl), .scl_mask = _BV(bit_scl) }
+#define TINYI2C_BUS_GPIO(sda_port, sda_bit, scl_port, scl_bit) \
+	TINYI2C_BUS_GPIO_REGS(DDR##sda_port, PORT##sda_port, PIN##sda_port, sda_bit, DDR##scl_port, PORT##scl_port, PIN##scl_port, scl_bit)
+#endif
+
+#define TINYI2C_DEFAULT_BUS		(&TinyI2C_bus0)
+
+#ifdef USE_PARALLEL_BUS
+// 同時転送するバスの束の定義
+//   TINYI2C_PBUS pbus = TINYI2C_PBUS_GPIO(D, 0x0F, B, 0); // SDA=PD0-PD3 SCL=PB0
+#define TINYI2C_PBUS_GPIO(port_sda, lane_mask, port_scl, bit_scl) \
+	{ .sda_ddr = &DDR##port_sda, .sda_port = &PORT##port_sda, .sda_pin = &PIN##port_sda, .lanes = (lane_mask),	\
+	  .scl_ddr = &DDR##port_scl, .scl_port = &PORT##port_scl, .scl_pin = &PIN##port_scl, .scl_mask = _BV(bit_scl) }
+#endif
+
+// バスの基本操作(各バスのバックエンドを呼ぶ)
+#define TinyI2C_busClear(bus)				((bus)->ops->busClear(bus))
+#define TinyI2C_start(bus)					((bus)->ops->start(bus))
+#define TinyI2C_stop(bus)					((bus)->ops->stop(bus))
+#define TinyI2C_read(bus, ack_nack)			((bus)->ops->read((bus), (ack_nack)))
+#define TinyI2C_write(bus, data)			((bus)->ops->write((bus), (data)))
+#define TinyI2C_getStatus(bus)				((bus)->error)
+#define TinyI2C_clearStatus(bus)			((bus)->ops->clearStatus(bus))
+#define TinyI2C_setTimeout(bus, timeout_us)	((bus)->timeout = (timeout_us))
+#define TinyI2C_setRetry(bus, policy)		((bus)->retry = (policy))
+
+// TINYI2C_RETRY.retry_mask 用
+#define TINYI2C_RETRY_ON(status)	(1U << (status))
+
+#ifdef USE_REGISTER_BATCH
+#define TinyI2C_batch_setRegBit(batch, mem_addr, set_bit)		TinyI2C_batch_masksetRegBit(batch, mem_addr, set_bit, set_bit)
+#define TinyI2C_batch_clearRegBit(batch, mem_addr, clear_bit)	TinyI2C_batch_masksetRegBit(batch, mem_addr, clear_bit, 0x00)
+#endif
 /* variables -----------------------------------------------------------*/
+#ifdef __cplusplus
+extern "C" {
+#endif
+// バックエンド(TinyI2CMaster_USI.c / _GPIO.c / _Sim.c)
+#if TINYI2C_BACKEND == TINYI2C_BACKEND_SIM
+extern const TINYI2C_OPS TinyI2C_sim_ops;
+#else
+extern const TINYI2C_OPS TinyI2C_usi_ops;
+extern const TINYI2C_OPS TinyI2C_gpio_ops;
+#endif
+
+// 既定のバス(TinyI2CMaster.c) ドライバは何も指定しなければこれを使う
+extern TINYI2C_BUS TinyI2C_bus0;
+
+// 既定のリトライ方針(TinyI2CMaster.c)
+// RETRY 回まで、衝突・アービトレーション負け・バス使用中・PEC不一致とNACK(ビジーのデバイス)をリトライする
+extern const TINYI2C_RETRY TinyI2C_retry_default;
+
 /* function prototypes -------------------------------------------------*/
-void TinyI2C_Master_init( void );
-uint8_t TinyI2C_start( void );
-uint8_t TinyI2C_stop( void );
-uint8_t TinyI2C_read( uint8_t ack_nack );
-uint8_t TinyI2C_write( uint8_t data );
-uint8_t TinyI2C_Transfer( uint8_t data );
-uint8_t TinyI2C_read_data(uint8_t slave_7bit_addr, void* data, int size, uint8_t send_stop);
-uint8_t TinyI2C_write_data(uint8_t slave_7bit_addr, void* data, int size, uint8_t send_stop);
-uint8_t TinyI2C_readReg( uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t *data );
-uint8_t TinyI2C_masksetRegBit( uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t mask, uint8_t set_bit );
-uint8_t TinyI2C_setRegBit( uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t set_bit );
-uint8_t TinyI2C_clearRegBit( uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t clear_bit );
+// プロトコル層(TinyI2CMaster.c)
+void TinyI2C_Master_init( TINYI2C_BUS *bus );
+uint8_t TinyI2C_read_data(TINYI2C_BUS *bus, uint8_t slave_7bit_addr, void* data, int size, uint8_t send_stop);
+uint8_t TinyI2C_write_data(TINYI2C_BUS *bus, uint8_t slave_7bit_addr, void* data, int size, uint8_t send_stop);
+uint8_t TinyI2C_write_data_P( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, const uint8_t *progmem_data, int size, uint8_t send_stop );
+uint8_t TinyI2C_transfer_msgs( TINYI2C_BUS *bus, TINYI2C_MSG *msgs, uint8_t n );
+#ifdef USE_STREAM_TRANSFER
+uint8_t TinyI2C_read_stream( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, TINYI2C_CONSUMER consume, void *ctx, uint16_t size, uint8_t send_stop );
+uint8_t TinyI2C_write_stream( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, TINYI2C_PRODUCER produce, void *ctx, uint16_t size, uint8_t send_stop );
+#endif
+uint8_t TinyI2C_readReg( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t *data );
+uint8_t TinyI2C_readRegs( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint16_t mem_addr, uint8_t addr_width, uint8_t *data, uint8_t size );
+uint8_t TinyI2C_writeRegs( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint16_t mem_addr, uint8_t addr_width, const uint8_t *data, uint8_t size );
+uint8_t TinyI2C_writeRegs_P( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint16_t mem_addr, uint8_t addr_width, const uint8_t *progmem_data, uint8_t size );
+uint8_t TinyI2C_masksetRegBit( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t mask, uint8_t set_bit );
+uint8_t TinyI2C_setRegBit( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t set_bit );
+uint8_t TinyI2C_clearRegBit( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t mem_addr, uint8_t clear_bit );
+#ifdef USE_REGISTER_BATCH
+void TinyI2C_batch_init( TINYI2C_BATCH *batch, TINYI2C_BUS *bus, uint8_t slave_7bit_addr );
+uint8_t TinyI2C_batch_masksetRegBit( TINYI2C_BATCH *batch, uint8_t mem_addr, uint8_t mask, uint8_t set_bit );
+uint8_t TinyI2C_batch_commit( TINYI2C_BATCH *batch );
+#endif
+#ifdef USE_REGISTER_CACHE
+void TinyI2C_cache_attach( TINYI2C_REGCACHE *cache, TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t first_reg, uint8_t count, const uint8_t *volatile_mask );
+void TinyI2C_cache_invalidate( TINYI2C_REGCACHE *cache );
+void TinyI2C_cache_invalidateReg( TINYI2C_REGCACHE *cache, uint8_t reg );
+#endif
+#ifdef USE_SMBUS
+uint8_t TinyI2C_smbus_write( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t cmd, const uint8_t *data, uint8_t size, uint8_t flags );
+uint8_t TinyI2C_smbus_read( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t cmd, uint8_t *data, uint8_t size, uint8_t flags );
+uint8_t TinyI2C_smbus_blockRead( TINYI2C_BUS *bus, uint8_t slave_7bit_addr, uint8_t cmd, uint8_t *data, uint8_t *size, uint8_t flags );
+#endif
+#ifdef USE_TINYI2C_STATS
+uint8_t TinyI2C_stats_snapshot( TINYI2C_STATS *dst );
+void TinyI2C_stats_reset( void );
+#endif
+#ifdef USE_ASYNC_TRANSFER
+uint8_t TinyI2C_submit( TINYI2C_BUS *bus, TINYI2C_JOB *job );
+uint8_t TinyI2C_isBusy( TINYI2C_BUS *bus );
+#endif
+#ifdef USE_POLLED_TRANSFER
+uint8_t TinyI2C_begin( TINYI2C_BUS *bus, TINYI2C_JOB *job );
+uint8_t TinyI2C_poll( TINYI2C_BUS *bus );
+void TinyI2C_poll_delay( TINYI2C_BUS *bus, uint16_t us );
+#endif
+#ifdef USE_PARALLEL_BUS
+// 同時転送(TinyI2CMaster_Parallel.c)
+void TinyI2C_par_init( TINYI2C_PBUS *pbus );
+uint8_t TinyI2C_par_read_data( TINYI2C_PBUS *pbus, uint8_t slave_7bit_addr, uint8_t *const data[8], uint8_t size, uint8_t send_stop, uint8_t *nack_lanes );
+uint8_t TinyI2C_par_write_data( TINYI2C_PBUS *pbus, uint8_t slave_7bit_addr, const uint8_t *const data[8], uint8_t size, uint8_t send_stop, uint8_t *nack_lanes );
+#endif
+
+#ifdef __cplusplus
+}
+#endif
 
 #endif /* TINYI2CMASTER_H_ */
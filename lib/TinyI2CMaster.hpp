@@ -0,0 +1,447 @@
+//========================================================================
+// File Name    : TinyI2CMaster.hpp
+//
+// Title        : ATtiny用 ソフトウエアI2C C++テンプレート版(ヘッダのみ)
+// Revision     : 0.11
+// Notes        : ポート・ピン・速度・方針をテンプレート引数で固定し、
+//                ピンのマスクや待ち時間、転送長をコンパイル時に確定させる
+//                (sbi/cbi/sbis になり、固定長の転送はループが展開される)
+//
+//                  typedef TinyI2C<PortB, PB0, PB2, TINYI2C_SPEED_FAST> Lcd;
+//                  Lcd::init();
+//                  Lcd::send(ST7032I_ADDR, 0x40, 'A');     // ST7032i_Write と同じ2バイト
+//
+//                Cから使うときは TINYI2C_BUS_TEMPLATE() でバスを定義すれば
+//                TinyI2C_write_data() 等の既存APIがそのまま使える
+//                  TINYI2C_BUS lcd_bus = TINYI2C_BUS_TEMPLATE(Lcd);
+// Target MCU   : AVR series
+// Tool Chain   : avr-g++ (C++11以降)
+//
+// Revision History:
+// When         Who         Description of change
+// -----------  ----------- -----------------------
+// 2026/10/17   ばんと      新規作成
+// 2026/10/17   ばんと      send()をパラメータパックの展開で直列化、tLOW/tHIGHはTinyI2CMaster.hの表を使う
+// 2026/10/17   ばんと      TINYI2C_BUS_TEMPLATE() を指示付き初期化子にした(TINYI2C_BUSのメンバ順に依存しない)
+//------------------------------------------------------------------------
+// This code is distributed under Apache License 2.0 License
+//		which can be found at http://www.apache.org/licenses/
+//========================================================================
+
+#ifndef __TINYI2CMASTER_HPP_
+#define __TINYI2CMASTER_HPP_
+
+#ifndef __cplusplus
+#error "TinyI2CMaster.hpp is for C++ (use TinyI2CMaster.h from C)"
+#endif
+
+#include "TinyI2CMaster.h"
+
+#if TINYI2C_BACKEND == TINYI2C_BACKEND_SIM
+#error "TinyI2CMaster.hpp needs GPIO ports (not available on SIM)"
+#endif
+
+/* define --------------------------------------------------------------*/
+// ポートの定義 DDR/PORT/PIN の組を型にする(アドレスは定数のまま残る)
+#define TINYI2C_DEFINE_PORT(x)											\
+	struct Port##x														\
+	{																	\
+		static volatile uint8_t &ddr( void )  { return DDR##x; }		\
+		static volatile uint8_t &port( void ) { return PORT##x; }		\
+		static volatile uint8_t &pin( void )  { return PIN##x; }		\
+	}
+
+// テンプレート版のバスをCのAPIから使うためのバス初期化子
+// (指示付き初期化子はC++20から 以前の規格ではGNU拡張なので -Wpedantic で警告が出る)
+#define TINYI2C_BUS_TEMPLATE(driver)	{ .ops = &driver::ops }
+
+/* typedef -------------------------------------------------------------*/
+#ifdef PORTA
+TINYI2C_DEFINE_PORT(A);
+#endif
+#ifdef PORTB
+TINYI2C_DEFINE_PORT(B);
+#endif
+#ifdef PORTC
+TINYI2C_DEFINE_PORT(C);
+#endif
+#ifdef PORTD
+TINYI2C_DEFINE_PORT(D);
+#endif
+
+// 既定の方針(Cの TinyI2C_retry_default と同じ)
+struct TinyI2C_DefaultPolicy
+{
+	static const uint8_t  attempts   = RETRY;						// 試行回数(初回を含む)
+	static const uint16_t backoff_us = TINYI2C_RETRY_BACKOFF_US;	// リトライ前の待ち(us)
+	static const uint16_t timeout_us = TINYI2C_TIMEOUT_US;			// SCL High待ちの上限(us)
+	static const bool     stretch    = true;					// falseならクロックストレッチを待たない
+};
+
+// リトライもクロックストレッチ待ちもしない最小構成
+// (ストレッチしないスレーブ専用 LCD等)
+struct TinyI2C_FastPolicy
+{
+	static const uint8_t  attempts   = 1;
+	static const uint16_t backoff_us = 0;
+	static const uint16_t timeout_us = 0;
+	static const bool     stretch    = false;
+};
+
+//========================================================================
+//  I2Cバス(ポート・ピン・速度・方針ごとに別の型になる)
+//------------------------------------------------------------------------
+// Port   : PortA〜PortD (TINYI2C_DEFINE_PORT で定義したもの)
+// Sda    : SDAのビット番号
+// Scl    : SCLのビット番号
+// Speed  : TINYI2C_SPEED_STANDARD / FAST / FAST_PLUS
+// Policy : TinyI2C_DefaultPolicy 等
+// 備考: SDA/SCLは同じポートに置くこと オープンドレインはDDRの切り換えで作る
+//========================================================================
+template<class Port, uint8_t Sda, uint8_t Scl,
+		 uint8_t Speed = TINYI2C_SPEED, class Policy = TinyI2C_DefaultPolicy>
+class TinyI2C
+{
+	static_assert(Sda < 8 && Scl < 8 && Sda != Scl, "bad SDA/SCL bit");
+	static_assert(Speed <= TINYI2C_SPEED_FAST_PLUS, "unknown speed");
+	static_assert(Policy::attempts >= 1, "attempts must be >= 1");
+
+	static const uint8_t SDA = 1 << Sda;
+	static const uint8_t SCL = 1 << Scl;
+
+	// SCL Low/High 期間のサイクル数(I2C仕様 tLOW/tHIGH TinyI2CMaster.h の表を使う)
+	static const uint32_t T2 = TWI_NS_TO_CYCLES(TINYI2C_TLOW_NS(Speed));
+	static const uint32_t T4 = TWI_NS_TO_CYCLES(TINYI2C_THIGH_NS(Speed));
+
+	// Low = 出力(PORTは0)  High = 入力(プルアップで開放)
+	static void sdaLow( void )     { Port::ddr() |=  SDA; }
+	static void sdaRelease( void ) { Port::ddr() &= ~SDA; }
+	static bool sdaIsHigh( void )  { return Port::pin() & SDA; }
+	static void sclLow( void )     { Port::ddr() |=  SCL; }
+	static void sclRelease( void ) { Port::ddr() &= ~SCL; }
+	static bool sclIsHigh( void )  { return Port::pin() & SCL; }
+
+	// 1バイト中に起きたタイムアウト(転送の最後にまとめて見る)
+	static uint8_t &error( void ) { static uint8_t e; return e; }
+
+	//--------------------------------------------------------------------
+	//  SCLがHighになるのを待つ(Policy::stretch が false なら何もしない)
+	//--------------------------------------------------------------------
+	static bool waitSCL( void )
+	{
+		if (!Policy::stretch)
+		{
+			return true;
+		}
+		for (uint16_t n = Policy::timeout_us; !sclIsHigh(); n--)
+		{
+			if (n == 0)
+			{
+				return false;
+			}
+			__builtin_avr_delay_cycles(F_CPU / 1000000UL);
+		}
+		return true;
+	}
+
+	//--------------------------------------------------------------------
+	//  1ビット送受信(SCL Lowの状態で呼ぶ)
+	//--------------------------------------------------------------------
+	static uint8_t clock( uint8_t bit )
+	{
+		uint8_t sample;
+
+		if (bit)
+		{
+			sdaRelease();
+		}
+		else
+		{
+			sdaLow();
+		}
+		__builtin_avr_delay_cycles(T2);
+		sclRelease();
+		if (!waitSCL())
+		{
+			error() = TINYI2C_TIMEOUT;
+		}
+		__builtin_avr_delay_cycles(T4);
+		sample = sdaIsHigh() ? 1 : 0;
+		sclLow();
+
+		return sample;
+	}
+
+	//--------------------------------------------------------------------
+	//  失敗時の後始末(Cの TinyI2C_finish と同じ)
+	//--------------------------------------------------------------------
+	static uint8_t finish( uint8_t status, bool send_stop )
+	{
+		if (status == TINYI2C_TIMEOUT)
+		{
+			busClear();
+		}
+		else if (status != TINYI2C_NO_ERROR || send_stop)
+		{
+			uint8_t s = stop();
+			if (status == TINYI2C_NO_ERROR)
+			{
+				status = s;
+			}
+		}
+		return status;
+	}
+
+	static void backoff( uint8_t attempt )
+	{
+		for (uint16_t us = Policy::backoff_us << attempt; us > 0; us--)
+		{
+			__builtin_avr_delay_cycles(F_CPU / 1000000UL);
+		}
+	}
+
+	// Cのバス(TINYI2C_OPS)から呼ばれる入口 bus は使わない
+	static void c_init( TINYI2C_BUS * )                 { init(); }
+	static uint8_t c_busClear( TINYI2C_BUS * )          { return busClear(); }
+	static uint8_t c_start( TINYI2C_BUS *bus )          { bus->error = TINYI2C_NO_ERROR; return start(); }
+	static uint8_t c_stop( TINYI2C_BUS * )              { return stop(); }
+	static uint8_t c_read( TINYI2C_BUS *bus, uint8_t more )
+	{
+		uint8_t data = read(more == MORE_READ);
+		if (error() != TINYI2C_NO_ERROR)
+		{
+			bus->error = error();
+		}
+		return data;
+	}
+	static uint8_t c_write( TINYI2C_BUS *, uint8_t data ) { return write(data); }
+	static void c_clearStatus( TINYI2C_BUS *bus )       { bus->error = TINYI2C_NO_ERROR; error() = TINYI2C_NO_ERROR; }
+	static void c_idle( TINYI2C_BUS *, uint16_t us )
+	{
+		for (; us > 0; us--)
+		{
+			__builtin_avr_delay_cycles(F_CPU / 1000000UL);
+		}
+	}
+
+public:
+	// Cのバス用の操作テーブル(TINYI2C_BUS_TEMPLATE で使う)
+	static const TINYI2C_OPS ops;
+
+	//--------------------------------------------------------------------
+	//  初期化 PORTは0固定(内部プルアップなし)、SDA/SCLとも開放
+	//--------------------------------------------------------------------
+	static void init( void )
+	{
+		Port::port() &= ~(SDA | SCL);
+		Port::ddr()  &= ~(SDA | SCL);
+	}
+
+	//--------------------------------------------------------------------
+	//  バスクリア(SDAがLowに張り付いたときの復旧)
+	//--------------------------------------------------------------------
+	static uint8_t busClear( void )
+	{
+		sdaRelease();
+		for (uint8_t i = 0; i < 9 && !sdaIsHigh(); i++)
+		{
+			sclLow();
+			__builtin_avr_delay_cycles(T2);
+			sclRelease();
+			if (!waitSCL())
+			{
+				return TINYI2C_TIMEOUT;
+			}
+			__builtin_avr_delay_cycles(T4);
+		}
+		sclLow();
+		sdaLow();
+		__builtin_avr_delay_cycles(T2);
+		sclRelease();
+		waitSCL();
+		__builtin_avr_delay_cycles(T4);
+		sdaRelease();
+		__builtin_avr_delay_cycles(T2);
+
+		return sdaIsHigh() ? TINYI2C_NO_ERROR : TINYI2C_TIMEOUT;
+	}
+
+	//--------------------------------------------------------------------
+	//  スタートコンディション送信(リピートスタートも同じ)
+	//--------------------------------------------------------------------
+	static uint8_t start( void )
+	{
+		error() = TINYI2C_NO_ERROR;
+
+		sdaRelease();
+		__builtin_avr_delay_cycles(T2);
+		sclRelease();
+		if (!waitSCL())
+		{
+			return TINYI2C_TIMEOUT;
+		}
+		if (!sdaIsHigh() && busClear() != TINYI2C_NO_ERROR)
+		{
+			return TINYI2C_TIMEOUT;
+		}
+		__builtin_avr_delay_cycles(T2);				// tSU;STA
+		sdaLow();
+		__builtin_avr_delay_cycles(T4);				// tHD;STA
+		sclLow();
+
+		return TINYI2C_NO_ERROR;
+	}
+
+	//--------------------------------------------------------------------
+	//  ストップコンディションの送信
+	//--------------------------------------------------------------------
+	static uint8_t stop( void )
+	{
+		sdaLow();
+		__builtin_avr_delay_cycles(T2);
+		sclRelease();
+		if (!waitSCL())
+		{
+			sdaRelease();
+			return TINYI2C_TIMEOUT;
+		}
+		__builtin_avr_delay_cycles(T4);				// tSU;STO
+		sdaRelease();
+		__builtin_avr_delay_cycles(T2);				// tBUF
+
+		return TINYI2C_NO_ERROR;
+	}
+
+	//--------------------------------------------------------------------
+	//  1バイト読み込み more が true ならACK、false ならNACKを返す
+	//--------------------------------------------------------------------
+	static uint8_t read( bool more )
+	{
+		uint8_t data = 0;
+
+		for (uint8_t i = 0; i < 8; i++)
+		{
+			data = (data << 1) | clock(1);
+		}
+		clock(more ? 0 : 1);						// (N)ACK
+		sdaRelease();
+
+		return data;
+	}
+
+	//--------------------------------------------------------------------
+	//  1バイト書き込み
+	//--------------------------------------------------------------------
+	static uint8_t write( uint8_t data )
+	{
+		uint8_t nack;
+
+		for (uint8_t i = 0; i < 8; i++, data <<= 1)
+		{
+			clock(data & 0x80);
+		}
+		nack = clock(1);							// ACKを受ける
+		sdaRelease();
+
+		if (error() != TINYI2C_NO_ERROR)
+		{
+			return error();
+		}
+		return nack ? TINYI2C_SLAVE_NACK : TINYI2C_NO_ERROR;
+	}
+
+	//--------------------------------------------------------------------
+	//  並べたバイトを順に書き込む(パラメータパックの展開で直列のコードになる)
+	//  status がエラーになったら残りは送らない
+	//--------------------------------------------------------------------
+	template<typename... Bytes>
+	__attribute__((always_inline)) static inline uint8_t writeSeq( uint8_t status, Bytes... bytes )
+	{
+#if __cplusplus >= 201703L
+		((status = (status == TINYI2C_NO_ERROR) ? write(static_cast<uint8_t>(bytes)) : status), ...);
+#else
+		// C++11/14 には畳み込み式がないので、初期化子リストの左から順の評価で展開する
+		const uint8_t seq[] = { (status = (status == TINYI2C_NO_ERROR) ? write(static_cast<uint8_t>(bytes)) : status)..., 0 };
+		(void)seq;
+#endif
+		return status;
+	}
+
+	//--------------------------------------------------------------------
+	//  固定長の書き込み(START〜STOPまで)
+	//  send(addr, 0x40, c) のように並べたバイト数で転送長が決まる
+	//  バイトはコピーもループもせず write() の直列呼び出しに展開される
+	//  失敗したら Policy::attempts 回までやり直す
+	//--------------------------------------------------------------------
+	template<typename... Bytes>
+	static uint8_t send( uint8_t slave_7bit_addr, Bytes... bytes )
+	{
+		uint8_t status;
+
+		for (uint8_t attempt = 0; ; attempt++)
+		{
+			status = start();
+			if (status == TINYI2C_NO_ERROR)
+			{
+				status = write(slave_7bit_addr << 1);
+			}
+			status = writeSeq(status, bytes...);
+			status = finish(status, true);
+			if (status == TINYI2C_NO_ERROR || attempt + 1 >= Policy::attempts)
+			{
+				break;
+			}
+			backoff(attempt);
+		}
+		return status;
+	}
+
+	//--------------------------------------------------------------------
+	//  固定長の読み込み(START〜STOPまで) 転送長は配列の大きさ
+	//--------------------------------------------------------------------
+	template<uint8_t N>
+	static uint8_t receive( uint8_t slave_7bit_addr, uint8_t (&data)[N], bool send_stop = true )
+	{
+		static_assert(N > 0, "empty read");
+		uint8_t status;
+
+		for (uint8_t attempt = 0; ; attempt++)
+		{
+			status = start();
+			if (status == TINYI2C_NO_ERROR)
+			{
+				status = write((slave_7bit_addr << 1) | 0x01);
+			}
+			if (status == TINYI2C_NO_ERROR)
+			{
+				for (uint8_t i = 0; i < N; i++)
+				{
+					data[i] = read(i + 1 < N);
+				}
+				status = error();
+			}
+			status = finish(status, send_stop);
+			if (status == TINYI2C_NO_ERROR || attempt + 1 >= Policy::attempts)
+			{
+				break;
+			}
+			backoff(attempt);
+		}
+		return status;
+	}
+};
+
+template<class Port, uint8_t Sda, uint8_t Scl, uint8_t Speed, class Policy>
+const TINYI2C_OPS TinyI2C<Port, Sda, Scl, Speed, Policy>::ops =
+{
+	TinyI2C::c_init,
+	TinyI2C::c_busClear,
+	TinyI2C::c_start,
+	TinyI2C::c_stop,
+	TinyI2C::c_read,
+	TinyI2C::c_write,
+	TinyI2C::c_clearStatus,
+	TinyI2C::c_idle,
+};
+
+#endif /* __TINYI2CMASTER_HPP_ */
@@ -0,0 +1,452 @@
+//========================================================================
+// File Name    : TinyI2CMaster_GPIO.c
+//
+// Title        : 任意のGPIOピンを使ったソフトウエアI2C(GPIOバックエンド)
+// Revision     : 0.11
+// Notes        : SIM以外で有効 ピンはバスごとに TINYI2C_BUS_GPIO() で指定
+//                (既定のバスは TINYI2C_GPIO_SDA_xxx / TINYI2C_GPIO_SCL_xxx)
+//                オープンドレインはDDRの切り換えで作る(外部プルアップ必須)
+// Target MCU   : AVR series
+// Tool Chain   :
+//
+// Revision History:
+// When         Who         Description of change
+// -----------  ----------- -----------------------
+// 2026/10/17   ばんと      新規作成
+// 2026/10/17   ばんと      ピンをバスごとに持つ形に変更(複数バス対応)
+// 2026/10/17   ばんと      リトライのバックオフ待ち追加
+// 2026/10/17   ばんと      リトライのバックオフ待ちをTinyWaitで眠れるようにした
+// 2026/10/17   ばんと      マルチマスターのアービトレーション負けとバス使用中の検出追加
+// 2026/10/17   ばんと      マルチマスター: リピートスタートを使用中と判定しない(バスを持っているかを覚える)
+// 2026/10/17   ばんと      マルチマスター: アービトレーション負けの後は勝ったマスターのSTOPかバスアイドルまで使用中とする
+//------------------------------------------------------------------------
+// This code is distributed under Apache License 2.0 License
+//		which can be found at http://www.apache.org/licenses/
+//========================================================================
+
+/* Includes -------------------------------------------------------------*/
+#include "TinyI2CMaster.h"
+#include "TinyWait.h"
+
+#if TINYI2C_BACKEND != TINYI2C_BACKEND_SIM
+#include <avr/delay.h>
+
+/* local define ---------------------------------------------------------*/
+// サイクル単位の待ち(サブマイクロ秒まで正確)
+#define DELAY_T2()      __builtin_avr_delay_cycles(T2_TWI_CYCLES)
+#define DELAY_T4()      __builtin_avr_delay_cycles(T4_TWI_CYCLES)
+#define DELAY_1US()     __builtin_avr_delay_cycles(F_CPU / 1000000UL)
+
+/* local typedef --------------------------------------------------------*/
+/* local macro ----------------------------------------------------------*/
+// Low = 出力(PORTは0)  High = 入力(プルアップで開放)
+#define SDA_LOW()       (*bus->sda_ddr |=  bus->sda_mask)
+#define SDA_RELEASE()   (*bus->sda_ddr &= ~bus->sda_mask)
+#define SDA_IS_HIGH()   (*bus->sda_pin &   bus->sda_mask)
+#define SCL_LOW()       (*bus->scl_ddr |=  bus->scl_mask)
+#define SCL_RELEASE()   (*bus->scl_ddr &= ~bus->scl_mask)
+#define SCL_IS_HIGH()   (*bus->scl_pin &   bus->scl_mask)
+
+/* local variables ------------------------------------------------------*/
+/* local function prototypes --------------------------------------------*/
+static void TinyI2C_gpio_init( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_gpio_busClear( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_gpio_start( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_gpio_stop( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_gpio_read( TINYI2C_BUS *bus, uint8_t more );
+static uint8_t TinyI2C_gpio_write( TINYI2C_BUS *bus, uint8_t data );
+static void TinyI2C_gpio_clearStatus( TINYI2C_BUS *bus );
+static void TinyI2C_gpio_idle( TINYI2C_BUS *bus, uint16_t us );
+static uint8_t TinyI2C_waitSCL( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_clock( TINYI2C_BUS *bus, uint8_t bit );
+#ifdef USE_MULTI_MASTER
+static void TinyI2C_gpio_watch( TINYI2C_BUS *bus, uint16_t us );
+#endif
+
+/* variables ------------------------------------------------------------*/
+const TINYI2C_OPS TinyI2C_gpio_ops =
+{
+    TinyI2C_gpio_init,
+    TinyI2C_gpio_busClear,
+    TinyI2C_gpio_start,
+    TinyI2C_gpio_stop,
+    TinyI2C_gpio_read,
+    TinyI2C_gpio_write,
+    TinyI2C_gpio_clearStatus,
+    TinyI2C_gpio_idle,
+};
+
+/* [ここからソース] ==================================================== */
+
+//========================================================================
+//  GPIOの初期化
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: なし
+//========================================================================
+static void TinyI2C_gpio_init( TINYI2C_BUS *bus )
+{
+    // PORTは0固定(内部プルアップなし)、SDA/SCLとも開放
+    *bus->sda_port &= ~bus->sda_mask;
+    *bus->scl_port &= ~bus->scl_mask;
+    SDA_RELEASE();
+    SCL_RELEASE();
+}
+
+//========================================================================
+//  SCLがHighになるのを待つ(クロックストレッチ対応、上限あり)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 0=正常終了　TINYI2C_TIMEOUT=上限時間を超えた
+//========================================================================
+static uint8_t TinyI2C_waitSCL( TINYI2C_BUS *bus )
+{
+    uint16_t n;
+
+    for (n = bus->timeout; !SCL_IS_HIGH(); n--)
+    {
+        if (n == 0)
+        {
+#ifdef USE_TINYI2C_STATS
+            bus->stretch = bus->timeout;
+#endif
+            return TINYI2C_TIMEOUT;
+        }
+        DELAY_1US();
+    }
+#ifdef USE_TINYI2C_STATS
+    if (bus->timeout - n > bus->stretch)
+    {
+        bus->stretch = bus->timeout - n;
+    }
+#endif
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  1ビット送受信(SCL Lowの状態で呼ぶ)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint8_t bit : 送信ビット(受信のときは1を渡してSDAを開放)
+// 戻値: SCL High中にサンプルしたSDA(0/1) タイムアウト時はbus->errorに記録
+//========================================================================
+static uint8_t TinyI2C_clock( TINYI2C_BUS *bus, uint8_t bit )
+{
+    uint8_t sample;
+
+    if (bit)
+    {
+        SDA_RELEASE();
+    }
+    else
+    {
+        SDA_LOW();
+    }
+    DELAY_T2();
+    SCL_RELEASE();
+    if (TinyI2C_waitSCL(bus) != TINYI2C_NO_ERROR)
+    {
+        bus->error = TINYI2C_TIMEOUT;
+    }
+    DELAY_T4();
+    sample = SDA_IS_HIGH() ? 1 : 0;
+    SCL_LOW();
+
+    return sample;
+}
+
+//========================================================================
+//  バスクリア(SDAがLowに張り付いたときの復旧)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 0=正常終了　TINYI2C_TIMEOUT=バスが解放されない
+// 備考: SDAを開放したままSCLを最大9回叩き、STOPコンディションを送る
+//========================================================================
+static uint8_t TinyI2C_gpio_busClear( TINYI2C_BUS *bus )
+{
+    uint8_t i;
+
+    SDA_RELEASE();
+    for (i = 0; i < 9; i++)
+    {
+        if (SDA_IS_HIGH())                      //スレーブがSDAを放した
+        {
+            break;
+        }
+        SCL_LOW();
+        DELAY_T2();
+        SCL_RELEASE();
+        if (TinyI2C_waitSCL(bus) != TINYI2C_NO_ERROR)
+        {
+            return TINYI2C_TIMEOUT;
+        }
+        DELAY_T4();
+    }
+
+    // STOPコンディション
+    SCL_LOW();
+    SDA_LOW();
+    DELAY_T2();
+    SCL_RELEASE();
+    if (TinyI2C_waitSCL(bus) != TINYI2C_NO_ERROR)
+    {
+        SDA_RELEASE();
+        return TINYI2C_TIMEOUT;
+    }
+    DELAY_T4();
+    SDA_RELEASE();
+    DELAY_T2();
+#ifdef USE_MULTI_MASTER
+    bus->owned = 0;
+#endif
+
+    if (!SDA_IS_HIGH())
+    {
+        return TINYI2C_TIMEOUT;
+    }
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  スタートコンディション送信(リピートスタートも同じ)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+// 備考: USE_MULTI_MASTER のときは、SCL/SDAがtBUFの間Highでなければ
+//       TINYI2C_BUS_BUSY(GPIOにはSTART/STOP検出がないので線を見る)
+//       リピートスタート(バスを持っている)ではSCLがLowなので見ない
+//========================================================================
+static uint8_t TinyI2C_gpio_start( TINYI2C_BUS *bus )
+{
+    bus->error = TINYI2C_NO_ERROR;
+
+    SDA_RELEASE();
+#ifdef USE_MULTI_MASTER
+    if (!bus->owned)
+    {
+        SCL_RELEASE();
+        if (bus->foreign)
+        {
+            TinyI2C_gpio_watch(bus, bus->timeout);  //負けた転送のSTOPかアイドルを待つ
+            if (bus->foreign)
+            {
+                return TINYI2C_BUS_BUSY;
+            }
+        }
+        if (!SCL_IS_HIGH() || !SDA_IS_HIGH())
+        {
+            return TINYI2C_BUS_BUSY;
+        }
+        DELAY_T2();                             // tBUF
+        if (!SCL_IS_HIGH() || !SDA_IS_HIGH())
+        {
+            return TINYI2C_BUS_BUSY;
+        }
+    }
+    else
+#endif
+    {
+        DELAY_T2();
+        SCL_RELEASE();
+    }
+    if (TinyI2C_waitSCL(bus) != TINYI2C_NO_ERROR)
+    {
+        return TINYI2C_TIMEOUT;
+    }
+    if (!SDA_IS_HIGH())                         //SDAが張り付いている
+    {
+        if (TinyI2C_gpio_busClear(bus) != TINYI2C_NO_ERROR)
+        {
+            return TINYI2C_TIMEOUT;
+        }
+    }
+    DELAY_T2();                                 // tSU;STA
+    SDA_LOW();
+    DELAY_T4();                                 // tHD;STA
+    SCL_LOW();
+#ifdef USE_MULTI_MASTER
+    bus->owned = 1;                             //STOPまでバスはこのマスターのもの
+#endif
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  ストップコンディションの送信
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+//========================================================================
+static uint8_t TinyI2C_gpio_stop( TINYI2C_BUS *bus )
+{
+#ifdef USE_MULTI_MASTER
+    bus->owned = 0;                             //失敗しても次のスタートは使用中か確かめる
+#endif
+    SDA_LOW();
+    DELAY_T2();
+    SCL_RELEASE();
+    if (TinyI2C_waitSCL(bus) != TINYI2C_NO_ERROR)
+    {
+        SDA_RELEASE();
+        return TINYI2C_TIMEOUT;
+    }
+    DELAY_T4();                                 // tSU;STO
+    SDA_RELEASE();
+    DELAY_T2();                                 // tBUF
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  1バイト読み込み(読み込み宣言のあと）
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint8_t more: more が MORE_READのときACK送信、それ以外はNACK送信
+// 戻値: 読み込まれた1バイトのデータ
+//========================================================================
+static uint8_t TinyI2C_gpio_read( TINYI2C_BUS *bus, uint8_t more )
+{
+    uint8_t data;
+    uint8_t i;
+
+    data = 0;
+    for (i = 0; i < 8; i++)
+    {
+        data = (data << 1) | TinyI2C_clock(bus, 1);
+    }
+#ifdef USE_MULTI_MASTER
+    if (TinyI2C_clock(bus, more == MORE_READ ? 0 : 1) == 0 && more != MORE_READ)
+    {
+        bus->error = TINYI2C_ARBITRATION_LOST;  //NACKが他のマスターのACKに負けた
+        bus->owned = 0;
+        bus->foreign = 1;                       //勝ったマスターのSTOPを見るまで使用中
+        SCL_RELEASE();
+    }
+#else
+    TinyI2C_clock(bus, more == MORE_READ ? 0 : 1);   // (N)ACK
+#endif
+    SDA_RELEASE();
+
+    return data;
+}
+
+//========================================================================
+//  1バイト書き込み
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint8_t data 書き込むデータ
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+//========================================================================
+static uint8_t TinyI2C_gpio_write( TINYI2C_BUS *bus, uint8_t data )
+{
+    uint8_t i;
+    uint8_t nack;
+
+    for (i = 0; i < 8; i++, data <<= 1)
+    {
+#ifdef USE_MULTI_MASTER
+        // 1を送ったのに0が見えたら負け すぐにバスを開放する
+        if (TinyI2C_clock(bus, data & 0x80) == 0 && (data & 0x80))
+        {
+            SDA_RELEASE();
+            SCL_RELEASE();
+            bus->error = TINYI2C_ARBITRATION_LOST;
+            bus->owned = 0;
+            bus->foreign = 1;                   //勝ったマスターのSTOPを見るまで使用中
+            return TINYI2C_ARBITRATION_LOST;
+        }
+#else
+        TinyI2C_clock(bus, data & 0x80);
+#endif
+    }
+    nack = TinyI2C_clock(bus, 1);                    // ACKを受ける
+    SDA_RELEASE();
+
+    if (bus->error != TINYI2C_NO_ERROR)
+    {
+        return bus->error;
+    }
+
+    return nack ? TINYI2C_SLAVE_NACK : TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  リトライ前にバス状態フラグをクリア
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: なし
+//========================================================================
+static void TinyI2C_gpio_clearStatus( TINYI2C_BUS *bus )
+{
+    bus->error = TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  バスを開放したまま待つ(リトライのバックオフ)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint16_t us      : 待ち時間(us)
+// 戻値: なし
+//========================================================================
+static void TinyI2C_gpio_idle( TINYI2C_BUS *bus, uint16_t us )
+{
+    (void)bus;
+
+#ifdef USE_MULTI_MASTER
+    if (bus->foreign)
+    {
+        TinyI2C_gpio_watch(bus, us);            //待つ間に他のマスターのSTOPを探す
+        return;
+    }
+#endif
+#ifdef USE_SLEEP_WAIT
+    TinyWait_us(us);                            //バスは開放したままなので眠ってよい
+#else
+    for (; us > 0; us--)
+    {
+        DELAY_1US();
+    }
+#endif
+}
+
+#ifdef USE_MULTI_MASTER
+//========================================================================
+//  他のマスターの転送の終わりを見張りながら待つ
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint16_t us      : 待ち時間(us)
+// 戻値: なし(終わりを見たら bus->foreign を0にする)
+// 備考: GPIOにはSTART/STOP検出がないので1usごとに線を見る
+//       SCL High のままSDAが立ち上がればSTOP、SCL/SDAが timeout の間
+//       Highのままならバスはアイドル(SMBusのバスアイドルと同じ考え)
+//========================================================================
+static void TinyI2C_gpio_watch( TINYI2C_BUS *bus, uint16_t us )
+{
+    uint8_t prev, now;
+    uint16_t high;
+
+    prev = (SCL_IS_HIGH() ? 2 : 0) | (SDA_IS_HIGH() ? 1 : 0);
+    high = 0;
+    for (; us > 0; us--)
+    {
+        DELAY_1US();
+        if (!bus->foreign)
+        {
+            continue;                           //終わりを見たら残りはただ待つ
+        }
+        now = (SCL_IS_HIGH() ? 2 : 0) | (SDA_IS_HIGH() ? 1 : 0);
+        high = (now == 3) ? high + 1 : 0;
+        if ((prev == 2 && now == 3) || high >= bus->timeout)
+        {
+            bus->foreign = 0;
+        }
+        prev = now;
+    }
+}
+#endif
+
+/* =====================================================[ここまでソース] */
+
+#endif  /* !TINYI2C_BACKEND_SIM */
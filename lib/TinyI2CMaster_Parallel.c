@@ -0,0 +1,395 @@
+//========================================================================
+// File Name    : TinyI2CMaster_Parallel.c
+//
+// Title        : 1ポートに並べた最大8バスの同時転送(ソフトウエアI2C)
+// Revision     : 0.11
+// Notes        : USE_PARALLEL_BUS のときだけ有効(SIMでは使えない)
+//                SDAを1つのポートに最大8本並べ、SCLは全バスで共通にする
+//                各クロックで全レーンのSDAをポートへの1回の書き込みで出すので
+//                N本のバスを1本分の時間で転送できる
+//                オープンドレインはDDRの切り換えで作る(外部プルアップ必須)
+// Target MCU   : AVR series
+// Tool Chain   :
+//
+// Revision History:
+// When         Who         Description of change
+// -----------  ----------- -----------------------
+// 2026/10/17   ばんと      新規作成
+// 2026/10/17   ばんと      タイムアウトで線を開放して戻る NACKしたレーンは次のクロックでSTOPを送って転送を終える
+//------------------------------------------------------------------------
+// This code is distributed under Apache License 2.0 License
+//		which can be found at http://www.apache.org/licenses/
+//========================================================================
+
+/* Includes -------------------------------------------------------------*/
+#include <stddef.h>
+#include "TinyI2CMaster.h"
+
+#if defined(USE_PARALLEL_BUS) && TINYI2C_BACKEND != TINYI2C_BACKEND_SIM
+#include <avr/delay.h>
+
+/* local define ---------------------------------------------------------*/
+// サイクル単位の待ち(サブマイクロ秒まで正確)
+#define DELAY_T2()      __builtin_avr_delay_cycles(T2_TWI_CYCLES)
+#define DELAY_T4()      __builtin_avr_delay_cycles(T4_TWI_CYCLES)
+#define DELAY_1US()     __builtin_avr_delay_cycles(F_CPU / 1000000UL)
+
+/* local typedef --------------------------------------------------------*/
+/* local macro ----------------------------------------------------------*/
+// Low = 出力(PORTは0)  High = 入力(プルアップで開放)
+#define SCL_LOW()       (*pbus->scl_ddr |=  pbus->scl_mask)
+#define SCL_RELEASE()   (*pbus->scl_ddr &= ~pbus->scl_mask)
+#define SCL_IS_HIGH()   (*pbus->scl_pin &   pbus->scl_mask)
+
+/* local variables ------------------------------------------------------*/
+static uint8_t par_error;                   // 転送中のタイムアウト
+
+/* local function prototypes --------------------------------------------*/
+static uint8_t TinyI2C_par_waitSCL( TINYI2C_PBUS *pbus );
+static uint8_t TinyI2C_par_clock( TINYI2C_PBUS *pbus, uint8_t low, uint8_t stop );
+static uint8_t TinyI2C_par_start( TINYI2C_PBUS *pbus, uint8_t slave_addr_rw );
+static uint8_t TinyI2C_par_stop( TINYI2C_PBUS *pbus );
+static uint8_t TinyI2C_par_shift_out( TINYI2C_PBUS *pbus, const uint8_t out[8], uint8_t active, uint8_t stop );
+static void TinyI2C_par_shift_in( TINYI2C_PBUS *pbus, uint8_t in[8], uint8_t active, uint8_t more );
+static void TinyI2C_par_release( TINYI2C_PBUS *pbus );
+
+/* [ここからソース] ==================================================== */
+
+//========================================================================
+//  バスの束の初期化
+//------------------------------------------------------------------------
+// 引数: TINYI2C_PBUS *pbus : バスの束(TINYI2C_PBUS_GPIO で定義したもの)
+// 戻値: なし
+//========================================================================
+void TinyI2C_par_init( TINYI2C_PBUS *pbus )
+{
+    if (pbus->timeout == 0)
+    {
+        pbus->timeout = TINYI2C_TIMEOUT_US;
+    }
+
+    // PORTは0固定(内部プルアップなし)、SDA/SCLとも開放
+    *pbus->sda_port &= ~pbus->lanes;
+    *pbus->scl_port &= ~pbus->scl_mask;
+    *pbus->sda_ddr &= ~pbus->lanes;
+    SCL_RELEASE();
+}
+
+//========================================================================
+//  データ連続読み込み(全レーン同時)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_PBUS *pbus       : バスの束
+//       uint8_t slave_7bit_addr  : ターゲットの7ビットアドレス(全レーン共通)
+//       uint8_t *const data[8]   : レーンごとの読み込み先(添字=SDAのビット番号)
+//       uint8_t size             : 読み込むデータサイズ(全レーン共通)
+//       uint8_t send_stop        : 非0なら読込後にSTOPコンディション送信する
+//       uint8_t *nack_lanes      : 失敗したレーン(NACK/SDA張り付き) NULL可
+// 戻値: 0=全レーン正常終了 TINYI2C_SLAVE_NACK=失敗したレーンがある
+//       TINYI2C_TIMEOUT=SCLが解放されない
+// 備考: 失敗したレーンはSDAを開放したまま他のレーンの転送を続ける
+//========================================================================
+uint8_t TinyI2C_par_read_data( TINYI2C_PBUS *pbus, uint8_t slave_7bit_addr, uint8_t *const data[8], uint8_t size, uint8_t send_stop, uint8_t *nack_lanes )
+{
+    uint8_t in[8];
+    uint8_t active, i, lane, bit;
+
+    active = TinyI2C_par_start(pbus, (slave_7bit_addr<<1) | 0x01);
+    for (i = 0; i < size && active != 0 && par_error == TINYI2C_NO_ERROR; i++)
+    {
+        TinyI2C_par_shift_in(pbus, in, active, (i + 1 < size) ? MORE_READ : NO_MORE_READ);
+        for (lane = 0, bit = 1; lane < 8; lane++, bit <<= 1)
+        {
+            if (active & bit)
+            {
+                data[lane][i] = in[lane];
+            }
+        }
+    }
+
+    if (par_error != TINYI2C_NO_ERROR)
+    {
+        TinyI2C_par_release(pbus);              //SCLもSDAも押さえたまま戻らない
+    }
+    else if (send_stop != 0)
+    {
+        TinyI2C_par_stop(pbus);
+    }
+
+    if (nack_lanes != NULL)
+    {
+        *nack_lanes = pbus->lanes & ~active;
+    }
+    if (par_error != TINYI2C_NO_ERROR)
+    {
+        return par_error;
+    }
+
+    return (active == pbus->lanes) ? TINYI2C_NO_ERROR : TINYI2C_SLAVE_NACK;
+}
+
+//========================================================================
+//  データ連続書き込み(全レーン同時)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_PBUS *pbus           : バスの束
+//       uint8_t slave_7bit_addr      : ターゲットの7ビットアドレス(全レーン共通)
+//       const uint8_t *const data[8] : レーンごとの書き込むデータ(添字=SDAのビット番号)
+//                                      全レーン同じデータなら同じポインタを並べてよい
+//       uint8_t size                 : 書き込むデータサイズ(全レーン共通)
+//       uint8_t send_stop            : 非0なら書込後にSTOPコンディション送信する
+//       uint8_t *nack_lanes          : 失敗したレーン(NACK/SDA張り付き) NULL可
+// 戻値: 0=全レーン正常終了 TINYI2C_SLAVE_NACK=失敗したレーンがある
+//       TINYI2C_TIMEOUT=SCLが解放されない
+// 備考: NACKを返したレーンは次のバイトの最初のクロックでSTOPを送って
+//       転送を終え、以降はSDAを開放したままにする(SCLは共通なので止められない)
+//       最後のバイトでNACKしたレーンは send_stop のSTOP(なければ次のSTART)で終わる
+//========================================================================
+uint8_t TinyI2C_par_write_data( TINYI2C_PBUS *pbus, uint8_t slave_7bit_addr, const uint8_t *const data[8], uint8_t size, uint8_t send_stop, uint8_t *nack_lanes )
+{
+    uint8_t out[8];
+    uint8_t active, nack, i, lane, bit;
+
+    active = TinyI2C_par_start(pbus, (slave_7bit_addr<<1) | 0x00);
+    nack = 0;
+    for (i = 0; i < size && active != 0 && par_error == TINYI2C_NO_ERROR; i++)
+    {
+        for (lane = 0, bit = 1; lane < 8; lane++, bit <<= 1)
+        {
+            if (active & bit)
+            {
+                out[lane] = data[lane][i];
+            }
+        }
+        nack = TinyI2C_par_shift_out(pbus, out, active, nack);
+        active &= ~nack;
+    }
+
+    if (par_error != TINYI2C_NO_ERROR)
+    {
+        TinyI2C_par_release(pbus);              //SCLもSDAも押さえたまま戻らない
+    }
+    else if (send_stop != 0)
+    {
+        TinyI2C_par_stop(pbus);
+    }
+
+    if (nack_lanes != NULL)
+    {
+        *nack_lanes = pbus->lanes & ~active;
+    }
+    if (par_error != TINYI2C_NO_ERROR)
+    {
+        return par_error;
+    }
+
+    return (active == pbus->lanes) ? TINYI2C_NO_ERROR : TINYI2C_SLAVE_NACK;
+}
+
+//========================================================================
+//  SCLがHighになるのを待つ(クロックストレッチ対応、上限あり)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_PBUS *pbus : バスの束
+// 戻値: 0=正常終了　TINYI2C_TIMEOUT=上限時間を超えた
+// 備考: SCLは共通なので、どのレーンのスレーブが伸ばしても全レーンが待つ
+//========================================================================
+static uint8_t TinyI2C_par_waitSCL( TINYI2C_PBUS *pbus )
+{
+    uint16_t n;
+
+    for (n = pbus->timeout; !SCL_IS_HIGH(); n--)
+    {
+        if (n == 0)
+        {
+            return TINYI2C_TIMEOUT;
+        }
+        DELAY_1US();
+    }
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  全レーン1ビット送受信(SCL Lowの状態で呼ぶ)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_PBUS *pbus : バスの束
+//       uint8_t low        : SDAをLowにするレーン(それ以外は開放)
+//       uint8_t stop       : このクロックでSTOPを送るレーン(SCL High中にSDAを開放)
+// 戻値: SCL High中にサンプルしたSDAのポート値 タイムアウト時はpar_errorに記録
+//========================================================================
+static uint8_t TinyI2C_par_clock( TINYI2C_PBUS *pbus, uint8_t low, uint8_t stop )
+{
+    uint8_t sample;
+
+    *pbus->sda_ddr = (*pbus->sda_ddr & ~pbus->lanes) | low | stop;   //全レーンを1回で出力
+    DELAY_T2();
+    SCL_RELEASE();
+    if (TinyI2C_par_waitSCL(pbus) != TINYI2C_NO_ERROR)
+    {
+        par_error = TINYI2C_TIMEOUT;
+    }
+    DELAY_T4();
+    sample = *pbus->sda_pin;
+    if (stop != 0)
+    {
+        *pbus->sda_ddr &= ~stop;                // tSU;STO はT4で満たしている
+        DELAY_T4();
+    }
+    SCL_LOW();
+
+    return sample;
+}
+
+//========================================================================
+//  スタートコンディションとアドレスの送信(全レーン同時)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_PBUS *pbus     : バスの束
+//       uint8_t slave_addr_rw  : アドレス+R/Wビット
+// 戻値: アドレスにACKを返したレーン
+// 備考: SDAがLowに張り付いたレーンはスタートせず、失敗として扱う
+//========================================================================
+static uint8_t TinyI2C_par_start( TINYI2C_PBUS *pbus, uint8_t slave_addr_rw )
+{
+    uint8_t active;
+    uint8_t out[8];
+    uint8_t lane;
+
+    par_error = TINYI2C_NO_ERROR;
+
+    *pbus->sda_ddr &= ~pbus->lanes;
+    DELAY_T2();
+    SCL_RELEASE();
+    if (TinyI2C_par_waitSCL(pbus) != TINYI2C_NO_ERROR)
+    {
+        par_error = TINYI2C_TIMEOUT;
+        return 0;
+    }
+    active = *pbus->sda_pin & pbus->lanes;      //SDAが開放されているレーンだけ使う
+    DELAY_T2();                                 // tSU;STA
+    *pbus->sda_ddr |= active;
+    DELAY_T4();                                 // tHD;STA
+    SCL_LOW();
+
+    for (lane = 0; lane < 8; lane++)
+    {
+        out[lane] = slave_addr_rw;
+    }
+
+    return active & ~TinyI2C_par_shift_out(pbus, out, active, 0);
+}
+
+//========================================================================
+//  ストップコンディションの送信(全レーン同時)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_PBUS *pbus : バスの束
+// 戻値: 0=正常終了　TINYI2C_TIMEOUT=SCLが解放されない
+//========================================================================
+static uint8_t TinyI2C_par_stop( TINYI2C_PBUS *pbus )
+{
+    *pbus->sda_ddr |= pbus->lanes;
+    DELAY_T2();
+    SCL_RELEASE();
+    if (TinyI2C_par_waitSCL(pbus) != TINYI2C_NO_ERROR)
+    {
+        *pbus->sda_ddr &= ~pbus->lanes;
+        par_error = TINYI2C_TIMEOUT;
+        return TINYI2C_TIMEOUT;
+    }
+    DELAY_T4();                                 // tSU;STO
+    *pbus->sda_ddr &= ~pbus->lanes;
+    DELAY_T2();                                 // tBUF
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  全レーン1バイト送信とACK受信
+//------------------------------------------------------------------------
+// 引数: TINYI2C_PBUS *pbus  : バスの束
+//       const uint8_t out[8]: レーンごとの送信データ(添字=SDAのビット番号)
+//       uint8_t active      : 送信するレーン(それ以外はSDA開放)
+//       uint8_t stop        : 最初のクロックでSTOPを送るレーン(前のバイトでNACKした)
+// 戻値: NACKを返したレーン
+// 備考: 先にビットごとのLowにするレーンを求めておき、クロック中は
+//       ポートへの書き込み1回だけにする(クロックの間隔をそろえるため)
+//========================================================================
+static uint8_t TinyI2C_par_shift_out( TINYI2C_PBUS *pbus, const uint8_t out[8], uint8_t active, uint8_t stop )
+{
+    uint8_t low[8];
+    uint8_t b, lane, bit, v;
+
+    for (b = 0; b < 8; b++)
+    {
+        low[b] = 0;
+    }
+    for (lane = 0, bit = 1; lane < 8; lane++, bit <<= 1)
+    {
+        if (!(active & bit))
+        {
+            continue;
+        }
+        for (b = 0, v = out[lane]; b < 8; b++, v <<= 1)
+        {
+            if (!(v & 0x80))
+            {
+                low[b] |= bit;
+            }
+        }
+    }
+
+    TinyI2C_par_clock(pbus, low[0], stop);
+    for (b = 1; b < 8; b++)
+    {
+        TinyI2C_par_clock(pbus, low[b], 0);
+    }
+
+    return TinyI2C_par_clock(pbus, 0, 0) & active; // ACKを受ける
+}
+
+//========================================================================
+//  全レーン1バイト受信と(N)ACK送信
+//------------------------------------------------------------------------
+// 引数: TINYI2C_PBUS *pbus : バスの束
+//       uint8_t in[8]      : レーンごとの受信データ(添字=SDAのビット番号)
+//       uint8_t active     : 受信するレーン
+//       uint8_t more       : MORE_READのときACK送信、それ以外はNACK送信
+// 戻値: なし
+// 備考: クロック中はポート値を取り込むだけにして、レーンへの振り分けは
+//       (N)ACKのあとにまとめて行う
+//========================================================================
+static void TinyI2C_par_shift_in( TINYI2C_PBUS *pbus, uint8_t in[8], uint8_t active, uint8_t more )
+{
+    uint8_t sample[8];
+    uint8_t b, lane, bit;
+
+    for (b = 0; b < 8; b++)
+    {
+        sample[b] = TinyI2C_par_clock(pbus, 0, 0);
+    }
+    TinyI2C_par_clock(pbus, (more == MORE_READ) ? active : 0, 0);   // (N)ACK
+    *pbus->sda_ddr &= ~pbus->lanes;
+
+    for (lane = 0, bit = 1; lane < 8; lane++, bit <<= 1)
+    {
+        in[lane] = 0;
+        for (b = 0; b < 8; b++)
+        {
+            in[lane] = (in[lane] << 1) | ((sample[b] & bit) ? 1 : 0);
+        }
+    }
+}
+
+//========================================================================
+//  全レーンのSDAとSCLを開放する(タイムアウト時)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_PBUS *pbus : バスの束
+// 戻値: なし
+// 備考: SCLが解放されないのでSTOPは送れない 復旧はスレーブ次第
+//========================================================================
+static void TinyI2C_par_release( TINYI2C_PBUS *pbus )
+{
+    *pbus->sda_ddr &= ~pbus->lanes;
+    SCL_RELEASE();
+}
+
+/* =====================================================[ここまでソース] */
+
+#endif  /* USE_PARALLEL_BUS */
@@ -0,0 +1,289 @@
+//========================================================================
+// File Name    : TinyI2CMaster_Sim.c
+//
+// Title        : ホスト用I2Cバス・シミュレータ(SIMバックエンド)
+// Revision     : 0.11
+// Notes        : TINYI2C_BACKEND == TINYI2C_BACKEND_SIM のときだけ有効
+//                TinyI2CMaster.c とドライバをホスト上で動かして試験・計測する
+// Target MCU   : Host (Linux etc.)
+// Tool Chain   : gcc
+//
+// Revision History:
+// When         Who         Description of change
+// -----------  ----------- -----------------------
+// 2026/10/17   ばんと      新規作成
+// 2026/10/17   ばんと      仮想スレーブをバスごとに接続する形に変更(複数バス対応)
+// 2026/10/17   ばんと      リトライ待ち時間のカウンタ追加
+//------------------------------------------------------------------------
+// This code is distributed under Apache License 2.0 License
+//		which can be found at http://www.apache.org/licenses/
+//========================================================================
+
+/* Includes -------------------------------------------------------------*/
+#include "TinyI2CMaster.h"
+
+#if TINYI2C_BACKEND == TINYI2C_BACKEND_SIM
+#include <stddef.h>
+#include <string.h>
+#include "TinyI2CMaster_Sim.h"
+
+/* local define ---------------------------------------------------------*/
+#define BIT_NS          (T2_TWI_NS + T4_TWI_NS)     // 1ビットのバス時間
+
+/* local typedef --------------------------------------------------------*/
+/* local macro ----------------------------------------------------------*/
+/* local variables ------------------------------------------------------*/
+static TINYI2C_SIM_DEVICE *sim_devices;     // 接続済みの仮想スレーブ
+static TINYI2C_SIM_DEVICE *sim_target;      // アドレス指定されたスレーブ
+static uint8_t sim_addressing;              // 次の書き込みはアドレス
+static uint8_t sim_index;                   // START後のデータバイト数
+static TINYI2C_SIM_STATS sim_stats;
+
+/* local function prototypes --------------------------------------------*/
+static void TinyI2C_sim_init( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_sim_busClear( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_sim_start( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_sim_stop( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_sim_read( TINYI2C_BUS *bus, uint8_t more );
+static uint8_t TinyI2C_sim_write( TINYI2C_BUS *bus, uint8_t data );
+static void TinyI2C_sim_clearStatus( TINYI2C_BUS *bus );
+static void TinyI2C_sim_idle( TINYI2C_BUS *bus, uint16_t us );
+
+/* variables ------------------------------------------------------------*/
+const TINYI2C_OPS TinyI2C_sim_ops =
+{
+    TinyI2C_sim_init,
+    TinyI2C_sim_busClear,
+    TinyI2C_sim_start,
+    TinyI2C_sim_stop,
+    TinyI2C_sim_read,
+    TinyI2C_sim_write,
+    TinyI2C_sim_clearStatus,
+    TinyI2C_sim_idle,
+};
+
+/* [ここからソース] ==================================================== */
+
+//========================================================================
+//  仮想スレーブの接続
+//------------------------------------------------------------------------
+// 引数: TINYI2C_SIM_DEVICE *dev  : 仮想スレーブ(on_write/on_read/regs は設定済み)
+//       TINYI2C_BUS *bus         : 接続するバス
+//       uint8_t slave_7bit_addr  : 7ビットアドレス
+// 戻値: なし
+//========================================================================
+void TinyI2C_sim_attach( TINYI2C_SIM_DEVICE *dev, TINYI2C_BUS *bus, uint8_t slave_7bit_addr )
+{
+    dev->bus = bus;
+    dev->slave_7bit_addr = slave_7bit_addr;
+    dev->next = sim_devices;
+    sim_devices = dev;
+}
+
+//========================================================================
+//  カウンタの取得
+//------------------------------------------------------------------------
+// 引数: TINYI2C_SIM_STATS *stats : 格納先
+// 戻値: なし
+//========================================================================
+void TinyI2C_sim_getStats( TINYI2C_SIM_STATS *stats )
+{
+    *stats = sim_stats;
+}
+
+//========================================================================
+//  カウンタのクリア
+//------------------------------------------------------------------------
+// 引数: なし
+// 戻値: なし
+//========================================================================
+void TinyI2C_sim_resetStats( void )
+{
+    memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+//========================================================================
+//  バスの初期化
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: なし
+//========================================================================
+static void TinyI2C_sim_init( TINYI2C_BUS *bus )
+{
+    (void)bus;
+
+    sim_target = NULL;
+    sim_addressing = 0;
+}
+
+//========================================================================
+//  バスクリア
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 0=正常終了
+//========================================================================
+static uint8_t TinyI2C_sim_busClear( TINYI2C_BUS *bus )
+{
+    return TinyI2C_sim_stop(bus);
+}
+
+//========================================================================
+//  スタートコンディション送信(リピートスタートも同じ)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 0=正常終了
+//========================================================================
+static uint8_t TinyI2C_sim_start( TINYI2C_BUS *bus )
+{
+    (void)bus;
+
+    sim_target = NULL;
+    sim_addressing = 1;
+    sim_index = 0;
+    sim_stats.starts++;
+    sim_stats.bus_ns += BIT_NS;
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  ストップコンディションの送信
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 0=正常終了
+//========================================================================
+static uint8_t TinyI2C_sim_stop( TINYI2C_BUS *bus )
+{
+    (void)bus;
+
+    sim_target = NULL;
+    sim_addressing = 0;
+    sim_stats.stops++;
+    sim_stats.bus_ns += BIT_NS;
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  1バイト読み込み
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint8_t more: MORE_READのときACK送信、それ以外はNACK送信
+// 戻値: 読み込まれた1バイトのデータ(スレーブがいなければ0xFF)
+//========================================================================
+static uint8_t TinyI2C_sim_read( TINYI2C_BUS *bus, uint8_t more )
+{
+    uint8_t data;
+
+    (void)bus;
+    (void)more;
+    sim_stats.bytes_in++;
+    sim_stats.bus_ns += 9 * BIT_NS;
+
+    if (sim_target == NULL)
+    {
+        return 0xFF;                            //プルアップのまま
+    }
+    if (sim_target->on_read != NULL)
+    {
+        data = sim_target->on_read(sim_target);
+    }
+    else
+    {
+        data = sim_target->regs[sim_target->reg_ptr++];
+    }
+
+    return data;
+}
+
+//========================================================================
+//  1バイト書き込み
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint8_t data 書き込むデータ
+// 戻値: 0=正常終了　TINYI2C_SLAVE_NACK=NACK
+//========================================================================
+static uint8_t TinyI2C_sim_write( TINYI2C_BUS *bus, uint8_t data )
+{
+    TINYI2C_SIM_DEVICE *dev;
+    uint8_t ack;
+
+    sim_stats.bytes_out++;
+    sim_stats.bus_ns += 9 * BIT_NS;
+
+    if (sim_addressing)
+    {
+        sim_addressing = 0;
+        for (dev = sim_devices; dev != NULL; dev = dev->next)
+        {
+            if (dev->bus == bus && dev->slave_7bit_addr == (data >> 1) && !dev->nack)
+            {
+                sim_target = dev;
+                return TINYI2C_NO_ERROR;
+            }
+        }
+        sim_stats.nacks++;
+        return TINYI2C_SLAVE_NACK;
+    }
+
+    if (sim_target == NULL)
+    {
+        sim_stats.nacks++;
+        return TINYI2C_SLAVE_NACK;
+    }
+
+    if (sim_target->on_write != NULL)
+    {
+        ack = sim_target->on_write(sim_target, sim_index, data);
+    }
+    else
+    {
+        if (sim_index == 0)
+        {
+            sim_target->reg_ptr = data;         //レジスタポインタ
+        }
+        else
+        {
+            sim_target->regs[sim_target->reg_ptr++] = data;
+        }
+        ack = TINYI2C_SIM_ACK;
+    }
+    sim_index++;
+
+    if (ack != TINYI2C_SIM_ACK)
+    {
+        sim_stats.nacks++;
+        return TINYI2C_SLAVE_NACK;
+    }
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  リトライ前にバス状態フラグをクリア
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: なし
+//========================================================================
+static void TinyI2C_sim_clearStatus( TINYI2C_BUS *bus )
+{
+    bus->error = TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  バスを開放したまま待つ(リトライのバックオフ)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint16_t us      : 待ち時間(us)
+// 戻値: なし
+// 備考: 実際には待たず、待ち時間をカウンタに加える
+//========================================================================
+static void TinyI2C_sim_idle( TINYI2C_BUS *bus, uint16_t us )
+{
+    (void)bus;
+    sim_stats.idle_ns += (uint64_t)us * 1000;
+}
+
+/* =====================================================[ここまでソース] */
+
+#endif  /* TINYI2C_BACKEND_SIM */
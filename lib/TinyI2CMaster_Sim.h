@@ -0,0 +1,69 @@
+//========================================================================
+// File Name    : TinyI2CMaster_Sim.h
+//
+// Title        : ホスト用I2Cバス・シミュレータ(SIMバックエンド)ヘッダファイル
+// Revision     : 0.11
+// Notes        : TINYI2C_BACKEND == TINYI2C_BACKEND_SIM のときだけ有効
+//                例: gcc -DTINYI2C_BACKEND=2 -Ilib app.c lib/*.c
+//                (ドライバが使う delay.h の wait_ms() 等はホスト側で用意する)
+// Target MCU   : Host (Linux etc.)
+// Tool Chain   : gcc
+//
+// Revision History:
+// When         Who         Description of change
+// -----------  ----------- -----------------------
+// 2026/10/17   ばんと      新規作成
+// 2026/10/17   ばんと      仮想スレーブをバスごとに接続する形に変更(複数バス対応)
+// 2026/10/17   ばんと      リトライ待ち時間のカウンタ追加
+//------------------------------------------------------------------------
+// This code is distributed under Apache License 2.0 License
+//		which can be found at http://www.apache.org/licenses/
+//========================================================================
+
+#ifndef __TINYI2CMASTER_SIM_H_
+#define __TINYI2CMASTER_SIM_H_
+
+#include "TinyI2CMaster.h"
+
+/* define --------------------------------------------------------------*/
+#define TINYI2C_SIM_ACK		0
+#define TINYI2C_SIM_NACK	1
+
+/* typedef -------------------------------------------------------------*/
+// 仮想スレーブ
+// コールバックがNULLなら「最初の書き込みバイトがレジスタポインタ、以降は
+// 自動インクリメントで読み書き」するレジスタファイルとして動作する
+typedef struct TINYI2C_SIM_DEVICE
+{
+	struct TINYI2C_SIM_DEVICE *next;
+	TINYI2C_BUS *bus;			// 接続先のバス
+	uint8_t slave_7bit_addr;	// 7ビットアドレス
+	uint8_t nack;				// 非0ならアドレスにNACKを返す(故障・ビジーの模擬)
+	uint8_t reg_ptr;			// レジスタポインタ
+	uint8_t regs[256];			// レジスタファイル
+	// 書き込み: index はSTART後の何バイト目か(0から) 戻値 ACK/NACK
+	uint8_t (*on_write)( struct TINYI2C_SIM_DEVICE *dev, uint8_t index, uint8_t data );
+	// 読み込み
+	uint8_t (*on_read)( struct TINYI2C_SIM_DEVICE *dev );
+} TINYI2C_SIM_DEVICE;
+
+// バスの累積カウンタ(ベンチマーク用)
+typedef struct
+{
+	uint32_t starts;			// START(リピートスタート含む)
+	uint32_t stops;				// STOP
+	uint32_t bytes_out;			// 送信バイト(アドレス含む)
+	uint32_t bytes_in;			// 受信バイト
+	uint32_t nacks;				// NACK
+	uint64_t bus_ns;			// 選択中の速度プロファイルでのバス占有時間(ns)
+	uint64_t idle_ns;			// リトライのバックオフで待った時間(ns)
+} TINYI2C_SIM_STATS;
+
+/* macro ---------------------------------------------------------------*/
+/* variables -----------------------------------------------------------*/
+/* function prototypes -------------------------------------------------*/
+void TinyI2C_sim_attach( TINYI2C_SIM_DEVICE *dev, TINYI2C_BUS *bus, uint8_t slave_7bit_addr );
+void TinyI2C_sim_getStats( TINYI2C_SIM_STATS *stats );
+void TinyI2C_sim_resetStats( void );
+
+#endif /* __TINYI2CMASTER_SIM_H_ */
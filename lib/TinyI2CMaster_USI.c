@@ -0,0 +1,1090 @@
+//========================================================================
+// File Name    : TinyI2CMaster_USI.c
+//
+// Title        : ATtiny用 USIを使ったI2Cドライバ(USIバックエンド)
+// Revision     : 0.11
+// Notes        : USI内蔵のデバイスで有効(SIMのときは無効)
+//                USIは1つしかないので TINYI2C_BUS_USI のバスは1本だけ定義すること
+// Target MCU   : AVR ATtiny series
+// Tool Chain   :
+//
+// Revision History:
+// When         Who         Description of change
+// -----------  ----------- -----------------------
+// ????/??/??   がた老さん  soft_I2C.c開発完了
+// 2013/04/10   ばんと      修正完了
+// 2013/04/26   ばんと      レジスタ操作関数追加&変更
+// 2026/10/17   ばんと      USI割り込みによる非同期転送追加
+// 2026/10/17   ばんと      F_CPUから求める通信速度プロファイル追加
+// 2026/10/17   ばんと      クロックストレッチ待ちのタイムアウトとバスクリア追加
+// 2026/10/17   ばんと      TinyI2CMaster.cからUSI依存部を分離
+// 2026/10/17   ばんと      TINYI2C_OPS経由で呼ばれる形に変更(複数バス対応)
+// 2026/10/17   ばんと      リトライのバックオフ待ち追加
+// 2026/10/17   ばんと      非同期転送でストリーム(コールバック)転送に対応
+// 2026/10/17   ばんと      サイクル数を数えたアセンブラの送受信カーネル追加
+// 2026/10/17   ばんと      リトライのバックオフ待ちをTinyWaitで眠れるようにした
+// 2026/10/17   ばんと      マルチマスターのアービトレーション負けとバス使用中の検出追加
+// 2026/10/17   ばんと      非同期転送のティックをF_CPUから決める(低いF_CPUで割り込みが追いつかない不具合修正)
+// 2026/10/17   ばんと      アセンブラカーネル: SCL開放直後の読み取りをやめ、同期化遅れと立ち上がり時間を待つ
+// 2026/10/17   ばんと      マルチマスター: リピートスタートを使用中と判定しない 負け判定を送ったビットとSDAの比較に 待機中のSTARTは割り込みで消す
+// 2026/10/17   ばんと      マルチマスター: アービトレーション負けの後は勝ったマスターのSTOPまで使用中とする
+//------------------------------------------------------------------------
+// This code is distributed under Apache License 2.0 License
+//		which can be found at http://www.apache.org/licenses/
+//========================================================================
+
+/* Includes -------------------------------------------------------------*/
+#include <stddef.h>
+#include "TinyI2CMaster.h"
+#include "TinyWait.h"
+
+#if TINYI2C_BACKEND != TINYI2C_BACKEND_SIM && defined(DDR_USI)
+#include <avr/delay.h>
+#if defined(USE_ASYNC_TRANSFER) || defined(USE_MULTI_MASTER)
+#include <avr/interrupt.h>
+#endif
+
+/* local define ---------------------------------------------------------*/
+#define TOGL_USICR      ((0<<USISIE)|(0<<USIOIE)|(1<<USIWM1)|(0<<USIWM0)|(1<<USICS1)|(0<<USICS0)|(1<<USICLK)|(1<<USITC))
+#define TEMP_USISR_8    ((1<<USISIF)|(1<<USIOIF)|(1<<USIPF)|(1<<USIDC)|(0x0<<USICNT0))
+#define TEMP_USISR_1    ((1<<USISIF)|(1<<USIOIF)|(1<<USIPF)|(1<<USIDC)|(0xE<<USICNT0))
+#ifdef USE_MULTI_MASTER
+// バスを手放した 次のスタートは使用中かどうか確かめ、それまでは他のマスターの
+// STARTを割り込みで拾う(START検出はUSISIFを消すまでSCLをLowに押さえるため)
+#define USI_RELEASE_BUS(bus)    ((bus)->owned = 0, USICR |= (1<<USISIE))
+#endif
+
+#ifdef USE_ASYNC_TRANSFER
+// 非同期転送ではオーバーフロー割り込みを許可したままSCLをトグルする
+#define ASYNC_TOGL_USICR    (TOGL_USICR | (1<<USIOIE))
+#define ASYNC_IDLE_USICR    (ASYNC_TOGL_USICR & ~(1<<USITC))
+
+// SCL半周期を刻むTimer0(CTCモード)の設定
+#if F_CPU < 1000000UL
+#error "USE_ASYNC_TRANSFER needs F_CPU >= 1MHz"
+#endif
+#define ASYNC_TICK_CYCLES   ((F_CPU / 1000000UL) * TINYI2C_ASYNC_TICK_US)
+#if ASYNC_TICK_CYCLES < TINYI2C_ASYNC_TICK_CYCLES
+#error "TINYI2C_ASYNC_TICK_US too short for F_CPU (the tick interrupt would not keep up)"
+#elif ASYNC_TICK_CYCLES > 8 * 256
+#error "TINYI2C_ASYNC_TICK_US too long for Timer0 (clk/8)"
+#endif
+#if ASYNC_TICK_CYCLES <= 256
+#define ASYNC_TCCR0B        (1<<CS00)                   // clk/1
+#define ASYNC_OCR0A         (ASYNC_TICK_CYCLES - 1)
+#else
+#define ASYNC_TCCR0B        (1<<CS01)                   // clk/8
+#define ASYNC_OCR0A         (ASYNC_TICK_CYCLES / 8 - 1)
+#endif
+
+#if defined(__AVR_ATtiny25__) | defined(__AVR_ATtiny45__) | defined(__AVR_ATtiny85__)
+#define ASYNC_USI_OVF_vect  USI_OVF_vect
+#elif defined(__AVR_AT90Tiny2313__) | defined(__AVR_ATtiny2313__)
+#define ASYNC_USI_OVF_vect  USI_OVERFLOW_vect
+#else
+#error "USE_ASYNC_TRANSFER is supported on ATtiny25/45/85/2313 only"
+#endif
+
+// タイマ割り込みで進めるバスの状態
+#define ASYNC_IDLE      0
+#define ASYNC_START_1   1       // SCL開放
+#define ASYNC_START_2   2       // SCL Highを待ってSDA Low
+#define ASYNC_START_3   3       // SCL Low、アドレス送信開始
+#define ASYNC_SHIFT     4       // USIでビット送受信中
+#define ASYNC_STOP_1    5       // SDA Low、SCL開放
+#define ASYNC_STOP_2    6       // SCL Highを待ってSDA開放
+#define ASYNC_STOP_3    7       // ストップコンディション確認、完了通知
+
+// オーバーフロー割り込みで進めるバイト単位の状態
+#define STEP_ADDR       0
+#define STEP_ADDR_ACK   1
+#define STEP_TX         2
+#define STEP_TX_ACK     3
+#define STEP_RX         4
+#define STEP_RX_ACK     5
+#endif
+
+#ifdef USE_USI_ASM_KERNEL
+// アセンブラカーネルのSCL波形(サイクル数)
+// SCLを開放したあと、PINxの同期化遅れ(nop 1サイクル)を置いてから、
+// 立ち上がり時間 tr の間SCLを見続け、Highを確認した時点からHigh期間を数える
+// 命令の分だけ Low は5サイクル、High は4サイクルより短くできない
+// 仕様の tLOW/tHIGH を満たしたうえで、周期(Low+1+High)が fSCL の上限を
+// 超えないよう Low を延ばす(表は立ち上がりが速い場合 遅ければその分周期が延びる)
+//
+//   F_CPU   STANDARD           FAST               FAST_PLUS
+//   (MHz)   Low/High  SCL      Low/High  SCL      Low/High  SCL
+//    1        5/4    100kHz      5/4    100kHz      5/4    100kHz
+//    2       11/8    100kHz      5/4    200kHz      5/4    200kHz
+//    4       23/16   100kHz      6/4    364kHz      5/4    400kHz
+//    8       47/32   100kHz     14/5    400kHz      5/4    800kHz
+//   10       59/40   100kHz     18/6    400kHz      5/4      1MHz
+//   12       71/48   100kHz     21/8    400kHz      7/4      1MHz
+//   16       95/64   100kHz     29/10   400kHz     10/5      1MHz
+//   20      119/80   100kHz     37/12   400kHz     13/6      1MHz
+#if TINYI2C_SPEED == TINYI2C_SPEED_STANDARD
+#define KERNEL_PERIOD_NS    10000
+#define KERNEL_RISE_NS      1000                // tr(最大)
+#elif TINYI2C_SPEED == TINYI2C_SPEED_FAST
+#define KERNEL_PERIOD_NS    2500
+#define KERNEL_RISE_NS      300
+#else
+#define KERNEL_PERIOD_NS    1000
+#define KERNEL_RISE_NS      120
+#endif
+#define KERNEL_MAX(a, b)    ((a) > (b) ? (a) : (b))
+#define KERNEL_HIGH         KERNEL_MAX(T4_TWI_CYCLES, 4)
+#define KERNEL_LOW          (KERNEL_MAX(KERNEL_MAX(T2_TWI_CYCLES, 5) + KERNEL_HIGH + 1, TWI_NS_TO_CYCLES(KERNEL_PERIOD_NS)) - KERNEL_HIGH - 1)
+#define KERNEL_WAIT_LOW     (KERNEL_LOW - 5)    // sbis+rjmp+ldi+out の分を引く
+#define KERNEL_WAIT_HIGH    (KERNEL_HIGH - 4)   // sbic+rjmp+out の分を引く
+#define KERNEL_RISE_POLLS   (TWI_NS_TO_CYCLES(KERNEL_RISE_NS) / 5 + 1)  // 1回5サイクルのSCL確認を tr の間
+#if KERNEL_WAIT_LOW > 3 * 255 || KERNEL_WAIT_HIGH > 3 * 255 || KERNEL_RISE_POLLS > 255
+#error "USE_USI_ASM_KERNEL: F_CPU too high for the wait loop"
+#endif
+#endif
+
+// サイクル単位の待ち(サブマイクロ秒まで正確)
+#define DELAY_T2()      __builtin_avr_delay_cycles(T2_TWI_CYCLES)
+#define DELAY_T4()      __builtin_avr_delay_cycles(T4_TWI_CYCLES)
+#define DELAY_1US()     __builtin_avr_delay_cycles(F_CPU / 1000000UL)
+
+/* local typedef --------------------------------------------------------*/
+/* local macro ----------------------------------------------------------*/
+/* local variables ------------------------------------------------------*/
+#ifdef USE_ASYNC_TRANSFER
+static TINYI2C_BUS *async_bus;              // 非同期転送中のバス
+static TINYI2C_JOB *async_queue[TINYI2C_QUEUE_SIZE];
+static volatile uint8_t async_head;
+static volatile uint8_t async_count;
+static volatile uint8_t async_phase = ASYNC_IDLE;
+static uint8_t async_step;
+static uint8_t async_scl_high;
+static uint8_t async_reading;
+static uint8_t async_status;
+static uint8_t *async_ptr;
+static uint16_t async_remain;
+static uint8_t async_next;                  // 次に送るバイト(先読み)
+#ifdef USE_STREAM_TRANSFER
+static uint16_t async_index;                // コールバックに渡す位置
+#endif
+static uint16_t async_wait;                 // クロックストレッチの累積待ち(us)
+#endif
+#ifdef USE_MULTI_MASTER
+static volatile uint8_t usi_foreign;        // 他のマスターのSTARTを見て、まだSTOPを見ていない
+#endif
+
+/* local function prototypes --------------------------------------------*/
+static void TinyI2C_usi_init( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_usi_busClear( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_usi_start( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_usi_stop( TINYI2C_BUS *bus );
+static uint8_t TinyI2C_usi_read( TINYI2C_BUS *bus, uint8_t more );
+static uint8_t TinyI2C_usi_write( TINYI2C_BUS *bus, uint8_t data );
+static void TinyI2C_usi_clearStatus( TINYI2C_BUS *bus );
+static void TinyI2C_usi_idle( TINYI2C_BUS *bus, uint16_t us );
+static uint8_t TinyI2C_usi_transfer( TINYI2C_BUS *bus, uint8_t data );
+static uint8_t TinyI2C_waitSCL( TINYI2C_BUS *bus );
+#ifdef USE_USI_ASM_KERNEL
+static uint8_t TinyI2C_usi_kernel( void );
+#endif
+#ifdef USE_ASYNC_TRANSFER
+static void TinyI2C_async_begin( void );
+static void TinyI2C_async_stop( uint8_t status );
+static void TinyI2C_async_stretch( void );
+static void TinyI2C_async_fetch( TINYI2C_JOB *job );
+static void TinyI2C_async_store( TINYI2C_JOB *job, uint8_t data );
+#endif
+
+/* variables ------------------------------------------------------------*/
+const TINYI2C_OPS TinyI2C_usi_ops =
+{
+    TinyI2C_usi_init,
+    TinyI2C_usi_busClear,
+    TinyI2C_usi_start,
+    TinyI2C_usi_stop,
+    TinyI2C_usi_read,
+    TinyI2C_usi_write,
+    TinyI2C_usi_clearStatus,
+    TinyI2C_usi_idle,
+};
+
+/* [ここからがた老さんのソース] ======================================== */
+
+//========================================================================
+//  USIインタフェースの初期化(対応ポートも初期化)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: なし
+//========================================================================
+static void TinyI2C_usi_init( TINYI2C_BUS *bus )
+{
+    (void)bus;                             //USIは1つなのでバスの情報は使わない
+
+    USIDR = 0xFF;                          //release data reg
+
+    PORT_USI  |=(1<<PIN_USI_SCL)|(1<<PIN_USI_SDA); //ピンは内部プルアップ
+    DDR_USI   |=(1<<PIN_USI_SCL)|(1<<PIN_USI_SDA); //最初は出力方向にしておく
+
+    // 2wire mode  ソフトウエアクロック 最初はエッジでトグルしない(USITC=0)
+    USICR = TOGL_USICR;
+    USICR &= ~(1<<USITC);
+
+    //ステイタスレジスタはすべてクリア
+    USISR = TEMP_USISR_8;
+#ifdef USE_MULTI_MASTER
+    USI_RELEASE_BUS(bus);                  //他のマスターのSTARTは割り込みで拾う
+#endif
+
+#ifdef USE_ASYNC_TRANSFER
+    // Timer0 CTCモード 割り込みは転送開始時に許可する
+    TCCR0A = (1<<WGM01);
+    TCCR0B = ASYNC_TCCR0B;
+    OCR0A  = ASYNC_OCR0A;
+#endif
+}
+
+//========================================================================
+//  SCLがHighになるのを待つ(クロックストレッチ対応、上限あり)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 0=正常終了　TINYI2C_TIMEOUT=上限時間を超えた
+//========================================================================
+static uint8_t TinyI2C_waitSCL( TINYI2C_BUS *bus )
+{
+    uint16_t n;
+
+    for (n = bus->timeout; !(PIN_USI & (1<<PIN_USI_SCL)); n--)
+    {
+        if (n == 0)
+        {
+#ifdef USE_TINYI2C_STATS
+            bus->stretch = bus->timeout;
+#endif
+            return TINYI2C_TIMEOUT;
+        }
+        DELAY_1US();
+    }
+#ifdef USE_TINYI2C_STATS
+    if (bus->timeout - n > bus->stretch)
+    {
+        bus->stretch = bus->timeout - n;
+    }
+#endif
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  バスクリア(SDAがLowに張り付いたときの復旧)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 0=正常終了　TINYI2C_TIMEOUT=バスが解放されない
+// 備考: SDAを開放したままSCLを最大9回叩き、STOPコンディションを送る
+//========================================================================
+static uint8_t TinyI2C_usi_busClear( TINYI2C_BUS *bus )
+{
+    uint8_t i;
+
+    USIDR = 0xFF;                               //Release SDA
+    DDR_USI |= (1<<PIN_USI_SDA);
+    PORT_USI |= (1<<PIN_USI_SDA);
+
+    for (i = 0; i < 9; i++)
+    {
+        if (PIN_USI & (1<<PIN_USI_SDA))         //スレーブがSDAを放した
+        {
+            break;
+        }
+        PORT_USI &= ~(1<<PIN_USI_SCL);
+        DELAY_T2();
+        PORT_USI |= (1<<PIN_USI_SCL);
+        if (TinyI2C_waitSCL(bus) != TINYI2C_NO_ERROR)
+        {
+            return TINYI2C_TIMEOUT;
+        }
+        DELAY_T4();
+    }
+
+    // STOPコンディション
+    PORT_USI &= ~(1<<PIN_USI_SCL);
+    PORT_USI &= ~(1<<PIN_USI_SDA);
+    DELAY_T2();
+    PORT_USI |= (1<<PIN_USI_SCL);
+    if (TinyI2C_waitSCL(bus) != TINYI2C_NO_ERROR)
+    {
+        PORT_USI |= (1<<PIN_USI_SDA);
+        return TINYI2C_TIMEOUT;
+    }
+    DELAY_T4();
+    PORT_USI |= (1<<PIN_USI_SDA);
+    DELAY_T2();
+    USISR = TEMP_USISR_8;                       //ステイタスをクリア
+#ifdef USE_MULTI_MASTER
+    USI_RELEASE_BUS(bus);
+#endif
+
+    if (!(PIN_USI & (1<<PIN_USI_SDA)))
+    {
+        return TINYI2C_TIMEOUT;
+    }
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  スタートコンディション送信
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+// 備考: USE_MULTI_MASTER のときは、前回からの間に他のマスターのSTARTを
+//       見てSTOPをまだ見ていないか、SCL/SDAがLowならTINYI2C_BUS_BUSY
+//       (バスクリアはしない) リピートスタート(バスを持っている)では見ない
+//========================================================================
+static uint8_t TinyI2C_usi_start( TINYI2C_BUS *bus )
+{
+#ifdef USE_MULTI_MASTER
+    uint8_t flags;
+
+    USICR &= ~(1<<USISIE);                      //自分のSTARTを割り込みで拾わない
+    if (!bus->owned)
+    {
+        flags = USISR & ((1<<USISIF)|(1<<USIPF));
+        USISR = TEMP_USISR_8;                   //START検出でSCLを押さえないようにすぐ消す
+        if (flags == (1<<USISIF))
+        {
+            usi_foreign = 1;
+        }
+        else if (flags & (1<<USIPF))
+        {
+            usi_foreign = 0;                    //STOPを見たのでバスは空いた
+        }
+        if (usi_foreign || (PIN_USI & ((1<<PIN_USI_SCL)|(1<<PIN_USI_SDA))) != ((1<<PIN_USI_SCL)|(1<<PIN_USI_SDA)))
+        {
+            USI_RELEASE_BUS(bus);
+            return TINYI2C_BUS_BUSY;
+        }
+    }
+    USIDR = 0xFF;
+    DDR_USI |= (1<<PIN_USI_SDA);                //アービトレーション負けで入力にしていたら戻す
+#elif defined(NOISE_TESTING)                                // Test if any unexpected conditions have arrived prior to this execution.
+    if( USISR & (1<<USISIF) )
+    {
+        return TINYI2C_UNKNOWN_START;
+    }
+
+    if( USISR & (1<<USIPF) )
+    {
+        return TINYI2C_UNKNOWN_STOP;
+    }
+
+    if( USISR & (1<<USIDC) )
+    {
+        return TINYI2C_DATA_COLLISION;
+    }
+#endif
+
+    bus->error = TINYI2C_NO_ERROR;
+
+    PORT_USI |= (1<<PIN_USI_SCL);               //set SCL 1
+    if (TinyI2C_waitSCL(bus) != TINYI2C_NO_ERROR)  //wait SCL high
+    {
+        return TINYI2C_TIMEOUT;
+    }
+    if (!(PIN_USI & (1<<PIN_USI_SDA)))          //SDAが張り付いている
+    {
+        if (TinyI2C_usi_busClear(bus) != TINYI2C_NO_ERROR)
+        {
+            return TINYI2C_TIMEOUT;
+        }
+        PORT_USI |= (1<<PIN_USI_SCL);
+    }
+    DELAY_T2();
+    PORT_USI &= ~(1<<PIN_USI_SDA);              // Force SDA LOW
+    DELAY_T4();
+    PORT_USI &= ~(1<<PIN_USI_SCL);              //Pull SCL low
+    PORT_USI |=  (1<<PIN_USI_SDA);              //Release SDA
+#ifdef USE_MULTI_MASTER
+    bus->owned = 1;                             //STOPまでバスはこのマスターのもの
+#endif
+
+#ifdef SIGNAL_VERIFY
+    if(!(USISR & (1<<USISIF)))
+    {
+        return TINYI2C_MISS_START_COND;
+    }
+#endif
+
+    return TINYI2C_NO_ERROR;
+}
+
+
+//========================================================================
+//  ストップコンディションの送信
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+//========================================================================
+static uint8_t TinyI2C_usi_stop( TINYI2C_BUS *bus )
+{
+    uint8_t retval;
+
+    retval = TINYI2C_NO_ERROR;
+#ifdef USE_MULTI_MASTER
+    USI_RELEASE_BUS(bus);                       //失敗しても次のスタートは使用中か確かめる
+#endif
+
+    PORT_USI &= ~(1<<PIN_USI_SDA);              //pull SDA low
+    PORT_USI |=  (1<<PIN_USI_SCL);              //Release SCL
+    if (TinyI2C_waitSCL(bus) != TINYI2C_NO_ERROR)  //wait SCL high
+    {
+        PORT_USI |= (1<<PIN_USI_SDA);
+        return TINYI2C_TIMEOUT;
+    }
+    DELAY_T2();
+    PORT_USI |= (1<<PIN_USI_SDA);               // set SDA in High(Z)
+    DELAY_T4();
+#ifdef SIGNAL_VERIFY
+    if(!(USISR & (1<<USIPF)) )
+    {
+        retval = TINYI2C_MISS_STOP_COND;
+    }
+#endif
+    USISR |= (1<<USIPF);                        //clear stop condition
+
+    return retval;
+}
+
+
+//========================================================================
+//  1バイト読み込み(読み込み宣言のあと）
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint8_t more: more が MORE_READのときACK送信、それ以外はNACK送信
+// 戻値: 読み込まれた1バイトのデータ
+//========================================================================
+static uint8_t TinyI2C_usi_read( TINYI2C_BUS *bus, uint8_t more )
+{
+    uint8_t data;
+
+    DDR_USI &= ~(1<<PIN_USI_SDA);               //enable SDA as input
+    data = TinyI2C_usi_transfer(bus, TEMP_USISR_8);      //read 8 bits
+    if(more == MORE_READ)                       //if read more
+        USIDR = 0x00;                           //set ACK
+    else
+        USIDR =0xFF;                            // NACK
+    TinyI2C_usi_transfer(bus, TEMP_USISR_1);             // generate (N)ACK (1bit)
+
+    return data;
+}
+
+
+//========================================================================
+//  1バイト書き込み
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint8_t data 書き込むデータ
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+//========================================================================
+static uint8_t TinyI2C_usi_write( TINYI2C_BUS *bus, uint8_t data )
+{
+    uint8_t retval;
+
+    retval = TINYI2C_NO_ERROR;                  //
+
+    PORT_USI &= ~(1<<PIN_USI_SCL);              //Pull SCL low
+    USIDR = data;                               //set Data
+    TinyI2C_usi_transfer(bus, TEMP_USISR_8);
+#ifdef USE_MULTI_MASTER
+    if (bus->error == TINYI2C_ARBITRATION_LOST)
+    {
+        return TINYI2C_ARBITRATION_LOST;        //ACKは勝ったマスターが受ける
+    }
+#endif
+    DDR_USI &= ~(1<<PIN_USI_SDA);               //入力に切り換え
+    if(TinyI2C_usi_transfer(bus, TEMP_USISR_1) & 0x01)
+    {
+        retval = TINYI2C_SLAVE_NACK;            //listen to response
+    }
+    if (bus->error != TINYI2C_NO_ERROR)
+    {
+        retval = bus->error;
+    }
+
+    return retval;
+}
+
+//========================================================================
+//  USIインタフェースによるデータ送受信 8ビットも1ビットも同じ
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint8_t data: 送受信データ
+// 戻値: 0=正常終了　それ以外I2C通信エラー
+//========================================================================
+static uint8_t TinyI2C_usi_transfer( TINYI2C_BUS *bus, uint8_t data )
+{
+    uint8_t retval;
+#ifdef USE_MULTI_MASTER
+    uint8_t sent;
+#endif
+
+#ifdef USE_MULTI_MASTER
+    if (bus->error == TINYI2C_ARBITRATION_LOST)
+    {
+        return 0xFF;                            //負けたあとはバスに触らない
+    }
+#endif
+
+    USISR = data;
+#ifdef USE_USI_ASM_KERNEL
+    // ストレッチされたときだけCで待ち、High期間の残りから再開する
+    while (TinyI2C_usi_kernel())
+    {
+        if (TinyI2C_waitSCL(bus) != TINYI2C_NO_ERROR)
+        {
+            bus->error = TINYI2C_TIMEOUT;
+            USICR = TOGL_USICR;                 //SCLをLowに戻して中断
+            break;
+        }
+        DELAY_T4();
+        USICR = TOGL_USICR;
+        if (USISR & (1<<USIOIF))
+        {
+            break;
+        }
+    }
+#else
+    do
+    {
+        DELAY_T2();
+#ifdef USE_MULTI_MASTER
+        sent = USIDR & 0x80;                    //SDAに出ているビット(立ち上がりでUSIDRはシフトする)
+#endif
+        USICR = TOGL_USICR;                     //generate positive SCL edge
+        if (TinyI2C_waitSCL(bus) != TINYI2C_NO_ERROR)  //wait for SCL to go high
+        {
+            bus->error = TINYI2C_TIMEOUT;
+            USICR = TOGL_USICR;                 //SCLをLowに戻して中断
+            break;
+        }
+        DELAY_T4();
+#ifdef USE_MULTI_MASTER
+        // 出力中に1を送ったのにSDAがLow
+        // (USIDCはシフト後のbit7=次のビットと比べるので使えない)
+        if ((DDR_USI & (1<<PIN_USI_SDA)) && sent && !(PIN_USI & (1<<PIN_USI_SDA)))
+        {
+            bus->error = TINYI2C_ARBITRATION_LOST;
+            DDR_USI &= ~(1<<PIN_USI_SDA);       //SDAを即座に開放
+            USIDR = 0xFF;
+            usi_foreign = 1;                    //勝ったマスターのSTOPを見るまで使用中
+            USISR = (1<<USISIF)|(1<<USIPF);     //これより前のSTOPは数えない
+            USI_RELEASE_BUS(bus);
+            return 0xFF;                        //SCLはHighのまま(開放)で抜ける
+        }
+#endif
+        USICR = TOGL_USICR;
+    }
+    while(!(USISR &(1<<USIOIF)) );              //4bitカウンタ終了を待つ
+#endif
+
+    DELAY_T2();
+    retval = USIDR;                             //読み込みのときはデータが入る
+    USIDR = 0xFF;                               //Release SDA
+    DDR_USI |=(1<<PIN_USI_SDA);                 //出力モードに変える
+
+    return retval;
+}
+/* =========================================[ここまでかだ老さんのソース] */
+
+#ifdef USE_USI_ASM_KERNEL
+//========================================================================
+//  USIのクロック生成(サイクル数を数えたアセンブラ)
+//------------------------------------------------------------------------
+// 引数: なし(USISRのカウンタは呼ぶ前に設定しておく)
+// 戻値: 0=カウンタ終了(SCL Low)
+//       1=スレーブがSCLを押さえている(SCLは開放済み、High期間から再開すること)
+// 備考: Low期間は KERNEL_LOW、High期間はHighを確認してから KERNEL_HIGH サイクル
+//       待ちは ldi/dec/brne の3サイクルループ＋nopで作る
+//       SCLを開放した直後のPINxは同期化遅れと立ち上がり時間のため必ずLowに
+//       見えるので、nopを置いてから tr の間だけ見続け、それでもLowならストレッチ
+//========================================================================
+static uint8_t TinyI2C_usi_kernel( void )
+{
+    uint8_t ret;
+    uint8_t tmp;
+    uint8_t cnt;
+
+    __asm__ __volatile__ (
+        "1:                         \n\t"
+        "ldi    %[cnt], %[rp]       \n\t" // 立ち上がりを確認する回数
+        ".if %[kl]                  \n\t"
+        "ldi    %[tmp], %[kl]       \n"    // Low期間の待ち
+        "2:                         \n\t"
+        "dec    %[tmp]              \n\t"
+        "brne   2b                  \n\t"
+        ".endif                     \n\t"
+        ".rept  %[rl]               \n\t"
+        "nop                        \n\t"
+        ".endr                      \n\t"
+        "out    %[cr], %[togl]      \n\t" // SCL 立ち上がり
+        "nop                        \n"    // PINxの同期化遅れ
+        "6:                         \n\t"
+        "sbic   %[pin], %[scl]      \n\t"
+        "rjmp   7f                  \n\t" // Highになった
+        "dec    %[cnt]              \n\t"
+        "brne   6b                  \n\t"
+        "rjmp   4f                  \n"    // tr を過ぎてもLow ストレッチ
+        "7:                         \n\t"
+        ".if %[kh]                  \n\t"
+        "ldi    %[tmp], %[kh]       \n"    // High期間の待ち
+        "3:                         \n\t"
+        "dec    %[tmp]              \n\t"
+        "brne   3b                  \n\t"
+        ".endif                     \n\t"
+        ".rept  %[rh]               \n\t"
+        "nop                        \n\t"
+        ".endr                      \n\t"
+        "out    %[cr], %[togl]      \n\t" // SCL 立ち下がり
+        "sbis   %[sr], %[oif]       \n\t"
+        "rjmp   1b                  \n\t"
+        "clr    %[ret]              \n\t"
+        "rjmp   5f                  \n"
+        "4:                         \n\t"
+        "ldi    %[ret], 1           \n"
+        "5:                         \n\t"
+        : [ret]  "=&d" (ret),
+          [tmp]  "=&d" (tmp),
+          [cnt]  "=&d" (cnt)
+        : [togl] "r" ((uint8_t)TOGL_USICR),
+          [cr]   "I" (_SFR_IO_ADDR(USICR)),
+          [sr]   "I" (_SFR_IO_ADDR(USISR)),
+          [oif]  "I" (USIOIF),
+          [pin]  "I" (_SFR_IO_ADDR(PIN_USI)),
+          [scl]  "I" (PIN_USI_SCL),
+          [kl]   "n" (KERNEL_WAIT_LOW / 3),
+          [rl]   "n" (KERNEL_WAIT_LOW % 3),
+          [kh]   "n" (KERNEL_WAIT_HIGH / 3),
+          [rh]   "n" (KERNEL_WAIT_HIGH % 3),
+          [rp]   "n" (KERNEL_RISE_POLLS)
+        : "memory"
+    );
+
+    return ret;
+}
+#endif  /* USE_USI_ASM_KERNEL */
+
+
+/* [ここからばんとのソース] ============================================ */
+//========================================================================
+//  リトライ前にバス状態フラグをクリア
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+// 戻値: なし
+//========================================================================
+static void TinyI2C_usi_clearStatus( TINYI2C_BUS *bus )
+{
+    bus->error = TINYI2C_NO_ERROR;
+#ifdef USE_MULTI_MASTER
+    USISR = (1<<USIOIF)|(1<<USIDC);             //START/STOPの検出はスタートで確かめるので残す
+#else
+    USISR = TEMP_USISR_8;
+#endif
+}
+
+//========================================================================
+//  バスを開放したまま待つ(リトライのバックオフ)
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : バス
+//       uint16_t us      : 待ち時間(us)
+// 戻値: なし
+//========================================================================
+static void TinyI2C_usi_idle( TINYI2C_BUS *bus, uint16_t us )
+{
+    (void)bus;
+
+#ifdef USE_SLEEP_WAIT
+    TinyWait_us(us);                            //バスは開放したままなので眠ってよい
+#else
+    for (; us > 0; us--)
+    {
+        DELAY_1US();
+    }
+#endif
+}
+
+#ifdef USE_MULTI_MASTER
+//========================================================================
+//  USIスタートコンディション割り込み: 他のマスターのSTART
+//------------------------------------------------------------------------
+// 備考: バスを持っていない間だけ許可する(TOGL_USICRを書くと禁止される)
+//       USISIFを消してSCLを開放し、それより前に見たSTOPも無効にする
+//========================================================================
+ISR(USI_START_vect)
+{
+    usi_foreign = 1;
+    USISR = (1<<USISIF)|(1<<USIPF);
+}
+#endif
+
+#ifdef USE_ASYNC_TRANSFER
+//========================================================================
+//  非同期転送の登録
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : USIのバス
+//       TINYI2C_JOB *job : 転送記述子(完了まで呼び出し側で保持)
+// 戻値: 0=登録完了 TINYI2C_QUEUE_FULL=キューが満杯
+// 備考: 完了すると job->status に結果が入り、callback が呼ばれる
+//       非同期転送中はこのバスで同期版の関数を呼ばないこと(TinyI2C_isBusy()で確認)
+//       他のバスは非同期転送中でも使える
+//========================================================================
+uint8_t TinyI2C_submit( TINYI2C_BUS *bus, TINYI2C_JOB *job )
+{
+    uint8_t sreg;
+
+    sreg = SREG;
+    cli();
+    if (async_count >= TINYI2C_QUEUE_SIZE)
+    {
+        SREG = sreg;
+        return TINYI2C_QUEUE_FULL;
+    }
+
+    async_bus = bus;
+    job->status = TINYI2C_BUSY;
+    async_queue[(async_head + async_count) % TINYI2C_QUEUE_SIZE] = job;
+    async_count++;
+    if (async_phase == ASYNC_IDLE)
+    {
+        TinyI2C_async_begin();
+    }
+    SREG = sreg;
+
+    return TINYI2C_NO_ERROR;
+}
+
+//========================================================================
+//  非同期転送中か？
+//------------------------------------------------------------------------
+// 引数: TINYI2C_BUS *bus : USIのバス
+// 戻値: 0=アイドル 非0=転送中またはキューに残りあり
+//========================================================================
+uint8_t TinyI2C_isBusy( TINYI2C_BUS *bus )
+{
+    (void)bus;
+
+    return async_phase != ASYNC_IDLE;
+}
+
+//========================================================================
+//  キュー先頭の転送を開始(割り込み禁止状態で呼ぶこと)
+//------------------------------------------------------------------------
+// 引数: なし
+// 戻値: なし
+//========================================================================
+static void TinyI2C_async_begin( void )
+{
+    TINYI2C_JOB *job;
+
+    job = async_queue[async_head];
+    async_status = TINYI2C_NO_ERROR;
+    async_reading = (job->wsize == 0);
+    async_ptr = async_reading ? job->rdata : job->wdata;
+    async_remain = async_reading ? job->rsize : job->wsize;
+#ifdef USE_STREAM_TRANSFER
+    async_index = 0;
+#endif
+    async_phase = ASYNC_START_1;
+    async_wait = 0;
+
+    USICR = ASYNC_IDLE_USICR;
+    TCNT0 = 0;
+    TIFR = (1<<OCF0A);
+    TIMSK |= (1<<OCIE0A);
+}
+
+//========================================================================
+//  ストップコンディションへ移行
+//------------------------------------------------------------------------
+// 引数: uint8_t status : 転送結果
+// 戻値: なし
+//========================================================================
+static void TinyI2C_async_stop( uint8_t status )
+{
+    async_status = status;
+    USIDR = 0xFF;
+    DDR_USI |= (1<<PIN_USI_SDA);
+    USISR = TEMP_USISR_8;                       // USIOIFクリア
+    async_phase = ASYNC_STOP_1;
+}
+
+//========================================================================
+//  クロックストレッチ中の1ティック 上限を超えたら転送を打ち切る
+//------------------------------------------------------------------------
+// 引数: なし
+// 戻値: なし
+//========================================================================
+static void TinyI2C_async_stretch( void )
+{
+    async_wait += TINYI2C_ASYNC_TICK_US;
+    if (async_wait > async_bus->timeout)
+    {
+        async_status = TINYI2C_TIMEOUT;
+        USIDR = 0xFF;                           //Release SDA
+        DDR_USI |= (1<<PIN_USI_SDA);
+        PORT_USI |= (1<<PIN_USI_SCL) | (1<<PIN_USI_SDA);
+        async_phase = ASYNC_STOP_3;             //完了通知へ
+    }
+}
+
+//========================================================================
+//  Timer0 比較一致割り込み: SCL半周期ごとにバスを進める
+//========================================================================
+ISR(TIMER0_COMPA_vect)
+{
+    TINYI2C_JOB *job;
+
+    switch (async_phase)
+    {
+    case ASYNC_START_1:
+        PORT_USI |= (1<<PIN_USI_SCL);           //set SCL 1
+        async_phase = ASYNC_START_2;
+        break;
+
+    case ASYNC_START_2:
+        if (!(PIN_USI & (1<<PIN_USI_SCL)))      //クロックストレッチ中
+        {
+            TinyI2C_async_stretch();
+            break;
+        }
+        async_wait = 0;
+        PORT_USI &= ~(1<<PIN_USI_SDA);          // Force SDA LOW
+        async_phase = ASYNC_START_3;
+        break;
+
+    case ASYNC_START_3:
+        PORT_USI &= ~(1<<PIN_USI_SCL);          //Pull SCL low
+        PORT_USI |=  (1<<PIN_USI_SDA);          //Release SDA
+        job = async_queue[async_head];
+        USIDR = (job->slave_7bit_addr<<1) | async_reading;
+        USISR = TEMP_USISR_8;
+        async_step = STEP_ADDR;
+        async_scl_high = 0;
+        async_phase = ASYNC_SHIFT;
+        if (!async_reading && async_remain != 0)
+        {
+            TinyI2C_async_fetch(job);           //アドレスのシフト中に最初のバイトを用意
+        }
+        break;
+
+    case ASYNC_SHIFT:
+        if (async_scl_high)
+        {
+            if (!(PIN_USI & (1<<PIN_USI_SCL)))  //クロックストレッチ中
+            {
+                TinyI2C_async_stretch();
+                break;
+            }
+            async_wait = 0;
+            async_scl_high = 0;
+        }
+        else
+        {
+            async_scl_high = 1;
+        }
+        USICR = ASYNC_TOGL_USICR;               //カウンタ満了でUSI_OVF割り込み
+        break;
+
+    case ASYNC_STOP_1:
+        PORT_USI &= ~(1<<PIN_USI_SDA);          //pull SDA low
+        PORT_USI |=  (1<<PIN_USI_SCL);          //Release SCL
+        async_phase = ASYNC_STOP_2;
+        break;
+
+    case ASYNC_STOP_2:
+        if (!(PIN_USI & (1<<PIN_USI_SCL)))      //クロックストレッチ中
+        {
+            TinyI2C_async_stretch();
+            break;
+        }
+        async_wait = 0;
+        PORT_USI |= (1<<PIN_USI_SDA);           // set SDA in High(Z)
+        async_phase = ASYNC_STOP_3;
+        break;
+
+    case ASYNC_STOP_3:
+#ifdef SIGNAL_VERIFY
+        if (!(USISR & (1<<USIPF)) && async_status == TINYI2C_NO_ERROR)
+        {
+            async_status = TINYI2C_MISS_STOP_COND;
+        }
+#endif
+        USISR |= (1<<USIPF);                    //clear stop condition
+
+        job = async_queue[async_head];
+        async_head = (async_head + 1) % TINYI2C_QUEUE_SIZE;
+        async_count--;
+        job->status = async_status;
+        if (job->callback)
+        {
+            job->callback(job);                 //コールバック内で再登録してもよい
+        }
+
+        if (async_count != 0)
+        {
+            TinyI2C_async_begin();
+        }
+        else
+        {
+            TIMSK &= ~(1<<OCIE0A);
+            USICR = TOGL_USICR & ~(1<<USITC);   //同期版の設定に戻す
+            async_phase = ASYNC_IDLE;
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+//========================================================================
+//  USIカウンタ・オーバーフロー割り込み: 1バイト/1ビット転送完了
+//========================================================================
+ISR(ASYNC_USI_OVF_vect)
+{
+    TINYI2C_JOB *job;
+    uint8_t data;
+
+    data = USIDR;
+    USIDR = 0xFF;                               //Release SDA
+    DDR_USI |= (1<<PIN_USI_SDA);                //出力モードに変える
+
+    switch (async_step)
+    {
+    case STEP_ADDR:
+    case STEP_TX:
+        DDR_USI &= ~(1<<PIN_USI_SDA);           //ACKを受けるため入力に切り換え
+        USISR = TEMP_USISR_1;
+        async_step++;                           // → STEP_ADDR_ACK / STEP_TX_ACK
+        break;
+
+    case STEP_ADDR_ACK:
+    case STEP_TX_ACK:
+        if (data & 0x01)
+        {
+            TinyI2C_async_stop(TINYI2C_SLAVE_NACK);
+        }
+        else if (async_reading)
+        {
+            if (async_remain == 0)
+            {
+                TinyI2C_async_stop(TINYI2C_NO_ERROR);
+            }
+            else
+            {
+                DDR_USI &= ~(1<<PIN_USI_SDA);   //enable SDA as input
+                USISR = TEMP_USISR_8;
+                async_step = STEP_RX;
+            }
+        }
+        else if (async_remain != 0)
+        {
+            USIDR = async_next;
+            async_remain--;
+            USISR = TEMP_USISR_8;
+            async_step = STEP_TX;
+            if (async_remain != 0)
+            {
+                TinyI2C_async_fetch(async_queue[async_head]);   //シフト中に次のバイトを用意
+            }
+        }
+        else
+        {
+            job = async_queue[async_head];
+            if (job->rsize != 0)
+            {
+                // リピートスタートで読み込みへ
+                async_reading = 1;
+                async_ptr = job->rdata;
+                async_remain = job->rsize;
+#ifdef USE_STREAM_TRANSFER
+                async_index = 0;
+#endif
+                USISR = TEMP_USISR_8;           // USIOIFクリア
+                async_phase = ASYNC_START_1;
+            }
+            else
+            {
+                TinyI2C_async_stop(TINYI2C_NO_ERROR);
+            }
+        }
+        break;
+
+    case STEP_RX:
+        async_remain--;
+        USIDR = async_remain ? 0x00 : 0xFF;     // ACK / NACK
+        USISR = TEMP_USISR_1;
+        async_step = STEP_RX_ACK;
+        TinyI2C_async_store(async_queue[async_head], data);    //(N)ACKのシフト中に渡す
+        break;
+
+    case STEP_RX_ACK:
+        if (async_remain != 0)
+        {
+            DDR_USI &= ~(1<<PIN_USI_SDA);       //enable SDA as input
+            USISR = TEMP_USISR_8;
+            async_step = STEP_RX;
+        }
+        else
+        {
+            TinyI2C_async_stop(TINYI2C_NO_ERROR);
+        }
+        break;
+
+    default:
+        break;
+    }
+}
+
+//========================================================================
+//  次に送るバイトを async_next に用意する
+//------------------------------------------------------------------------
+// 引数: TINYI2C_JOB *job : 転送中の記述子
+// 戻値: なし
+//========================================================================
+static void TinyI2C_async_fetch( TINYI2C_JOB *job )
+{
+#ifdef USE_STREAM_TRANSFER
+    if (job->produce != NULL)
+    {
+        async_next = job->produce(job->ctx, async_index++);
+        return;
+    }
+#else
+    (void)job;
+#endif
+    async_next = *async_ptr++;
+}
+
+//========================================================================
+//  受信したバイトを渡す
+//------------------------------------------------------------------------
+// 引数: TINYI2C_JOB *job : 転送中の記述子
+//       uint8_t data     : 受信データ
+// 戻値: なし
+//========================================================================
+static void TinyI2C_async_store( TINYI2C_JOB *job, uint8_t data )
+{
+#ifdef USE_STREAM_TRANSFER
+    if (job->consume != NULL)
+    {
+        job->consume(job->ctx, async_index++, data);
+        return;
+    }
+#else
+    (void)job;
+#endif
+    *async_ptr++ = data;
+}
+#endif  /* USE_ASYNC_TRANSFER */
+/* =============================================[ここまでばんとのソース] */
+
+#endif  /* DDR_USI */
@@ -0,0 +1,238 @@
+//========================================================================
+// File Name    : TinyWait.c
+//
+// Title        : スリープで待つ時間待ちサービス
+// Revision     : 0.1
+// Notes        : USE_SLEEP_WAIT のときだけ有効
+//                Timer1(CTC)とウォッチドッグ割り込みを占有する
+//                パワーダウン中はTimer0/USIも止まるので、非同期転送
+//                (USE_ASYNC_TRANSFER)と併用するときは TINYWAIT_PDOWN_MS=0 にすること
+// Target MCU   : AVR ATtiny25/45/85
+// Tool Chain   :
+//
+// Revision History:
+// When         Who         Description of change
+// -----------  ----------- -----------------------
+// 2026/10/17   ばんと      新規作成
+//------------------------------------------------------------------------
+// This code is distributed under Apache License 2.0 License
+//		which can be found at http://www.apache.org/licenses/
+//========================================================================
+
+/* Includes -------------------------------------------------------------*/
+#include "TinyWait.h"
+
+#ifdef USE_SLEEP_WAIT
+#include <avr/io.h>
+#include <avr/delay.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+
+#if !(defined(__AVR_ATtiny25__) | defined(__AVR_ATtiny45__) | defined(__AVR_ATtiny85__))
+#error "USE_SLEEP_WAIT is supported on ATtiny25/45/85 only"
+#endif
+
+/* local define ---------------------------------------------------------*/
+#define DELAY_1US()     __builtin_avr_delay_cycles(F_CPU / 1000000UL)
+
+// Timer1のプリスケーラ
+#define T1_CS_8         (1<<CS12)                           // clk/8    (us単位の待ち)
+#define T1_CS_1024      ((1<<CS13)|(1<<CS11)|(1<<CS10))     // clk/1024 (ms単位の待ち)
+
+/* local typedef --------------------------------------------------------*/
+/* local macro ----------------------------------------------------------*/
+#define INTERRUPT_ENABLED()     (SREG & (1<<SREG_I))
+
+/* local variables ------------------------------------------------------*/
+static volatile uint8_t wait_done;          // 起床要因(Timer1/WDT)が来た
+
+/* local function prototypes --------------------------------------------*/
+static void TinyWait_sleep( uint8_t mode );
+static void TinyWait_timer( uint8_t cs, uint32_t ticks );
+#if TINYWAIT_PDOWN_MS > 0
+static uint16_t TinyWait_powerDown( uint16_t ms );
+#endif
+
+/* [ここからばんとのソース] ============================================ */
+//========================================================================
+//  待ち時間(us)
+//------------------------------------------------------------------------
+// 引数: uint16_t us : 待ち時間(us)
+// 戻値: なし
+// 備考: TINYWAIT_SPIN_US 未満はスピン それ以上はアイドルスリープ
+//========================================================================
+void TinyWait_us( uint16_t us )
+{
+    if (us < TINYWAIT_SPIN_US)
+    {
+        for (; us > 0; us--)
+        {
+            DELAY_1US();
+        }
+        return;
+    }
+
+    TinyWait_timer(T1_CS_8, ((uint32_t)us * (F_CPU / 1000000UL) + 7) / 8);
+}
+
+//========================================================================
+//  待ち時間(ms)
+//------------------------------------------------------------------------
+// 引数: uint16_t ms : 待ち時間(ms)
+// 戻値: なし
+// 備考: TINYWAIT_PDOWN_MS 以上はパワーダウン、残りはアイドルスリープ
+//========================================================================
+void TinyWait_ms( uint16_t ms )
+{
+#if TINYWAIT_PDOWN_MS > 0
+    if (ms >= TINYWAIT_PDOWN_MS && INTERRUPT_ENABLED())
+    {
+        ms -= TinyWait_powerDown(ms);
+    }
+#endif
+
+    TinyWait_timer(T1_CS_1024, ((uint32_t)ms * (F_CPU / 1000UL) + 1023) / 1024);
+}
+
+//========================================================================
+//  待ち時間(秒)
+//------------------------------------------------------------------------
+// 引数: uint8_t sec : 待ち時間(秒)
+// 戻値: なし
+//========================================================================
+void TinyWait_sec( uint8_t sec )
+{
+    for (; sec > 0; sec--)
+    {
+        TinyWait_ms(1000);
+    }
+}
+
+//========================================================================
+//  起床要因が来るまで眠る(他の割り込みで起きたら寝直す)
+//------------------------------------------------------------------------
+// 引数: uint8_t mode : SLEEP_MODE_IDLE / SLEEP_MODE_PWR_DOWN
+// 戻値: なし
+// 備考: 割り込み許可の状態で呼ぶこと
+//========================================================================
+static void TinyWait_sleep( uint8_t mode )
+{
+    set_sleep_mode(mode);
+    for (;;)
+    {
+        cli();
+        if (wait_done)
+        {
+            break;
+        }
+        sleep_enable();
+        sei();                                  //sei の次の命令までは割り込まれない
+        sleep_cpu();
+        sleep_disable();
+    }
+    sei();
+}
+
+//========================================================================
+//  Timer1で待つ
+//------------------------------------------------------------------------
+// 引数: uint8_t cs     : Timer1のプリスケーラ
+//       uint32_t ticks : 待つカウント数
+// 戻値: なし
+// 備考: 割り込み禁止で呼ばれたときは眠らずにフラグを見て待つ
+//========================================================================
+static void TinyWait_timer( uint8_t cs, uint32_t ticks )
+{
+    uint8_t n;
+
+    while (ticks > 0)
+    {
+        n = (ticks > 255) ? 255 : ticks;
+        ticks -= n;
+
+        TCCR1 = 0;
+        TCNT1 = 0;
+        OCR1A = n;
+        OCR1C = n;
+        TIFR = (1<<OCF1A);
+        if (INTERRUPT_ENABLED())
+        {
+            wait_done = 0;
+            TIMSK |= (1<<OCIE1A);
+            TCCR1 = (1<<CTC1) | cs;
+            TinyWait_sleep(SLEEP_MODE_IDLE);
+            TIMSK &= ~(1<<OCIE1A);
+        }
+        else
+        {
+            TCCR1 = (1<<CTC1) | cs;
+            while (!(TIFR & (1<<OCF1A)))
+            {
+                ;
+            }
+        }
+        TCCR1 = 0;
+    }
+}
+
+#if TINYWAIT_PDOWN_MS > 0
+//========================================================================
+//  ウォッチドッグでパワーダウンして待つ
+//------------------------------------------------------------------------
+// 引数: uint16_t ms : 待ち時間(ms)
+// 戻値: 待ったとみなす時間(ms) 残りは呼び出し側で待つ
+// 備考: WDTの発振は±10%程度ずれるので、公称の7/8だけ待ったとみなす
+//       8s〜16msの周期を大きい順に使い、16ms未満は残す
+//========================================================================
+static uint16_t TinyWait_powerDown( uint16_t ms )
+{
+    uint16_t credit;
+    uint16_t step;
+    uint8_t k;
+
+    credit = 0;
+    for (k = 10; k-- > 0; )
+    {
+        step = 16U << k;
+        while (ms - credit >= step)
+        {
+            wait_done = 0;
+            cli();
+            MCUSR &= ~(1<<WDRF);
+            WDTCR = (1<<WDCE) | (1<<WDE);       //変更は4サイクル以内
+            WDTCR = (1<<WDIE) | ((k & 8) ? (1<<WDP3) : 0) | (k & 7);
+            sei();
+
+            TinyWait_sleep(SLEEP_MODE_PWR_DOWN);
+
+            cli();
+            WDTCR = (1<<WDCE) | (1<<WDE);
+            WDTCR = 0;
+            sei();
+
+            credit += step - (step >> 3);
+        }
+    }
+
+    return credit;
+}
+#endif
+
+//========================================================================
+//  起床用の割り込み
+//========================================================================
+ISR(TIMER1_COMPA_vect)
+{
+    wait_done = 1;
+}
+
+#if TINYWAIT_PDOWN_MS > 0
+ISR(WDT_vect)
+{
+    wait_done = 1;
+}
+#endif
+
+/* =============================================[ここまでばんとのソース] */
+
+#endif  /* USE_SLEEP_WAIT */
@@ -0,0 +1,72 @@
+//========================================================================
+// File Name    : TinyWait.h
+//
+// Title        : スリープで待つ時間待ちサービス・ヘッダファイル
+// Revision     : 0.1
+// Notes        : USE_SLEEP_WAIT を定義すると待ち時間中はCPUを止める
+//                  TINYWAIT_SPIN_US 未満     : スピン(ビットタイミング用)
+//                  TINYWAIT_PDOWN_MS 未満    : アイドルスリープ+Timer1で起床
+//                  TINYWAIT_PDOWN_MS 以上    : パワーダウン+ウォッチドッグで起床
+//                待ちの間も割り込みは受け付ける
+//                定義しなければ delay.h の wait_ms/wait_sec を使う
+//                (usの待ちはAVRでは _delay_us(1) の繰り返し、ホストでは delay.h の wait_us)
+// Target MCU   : AVR ATtiny25/45/85
+// Tool Chain   :
+//
+// Revision History:
+// When         Who         Description of change
+// -----------  ----------- -----------------------
+// 2026/10/17   ばんと      新規作成
+// 2026/10/17   ばんと      USE_SLEEP_WAITなしのus待ちを _delay_us にした(delay.h に wait_us はない)
+//------------------------------------------------------------------------
+// This code is distributed under Apache License 2.0 License
+//		which can be found at http://www.apache.org/licenses/
+//========================================================================
+
+#ifndef __TINYWAIT_H_
+#define __TINYWAIT_H_
+
+#include <stdint.h>
+
+/* define --------------------------------------------------------------*/
+//#define USE_SLEEP_WAIT			// 待ち時間をスリープで過ごす(Timer1とWDT割り込みを使う)
+
+#define TINYWAIT_SPIN_US	10		// これより短い待ちはスピン(us)
+#ifndef TINYWAIT_PDOWN_MS
+#define TINYWAIT_PDOWN_MS	100		// これ以上の待ちはパワーダウン(ms) 0ならパワーダウンしない
+#endif
+
+/* function prototypes -------------------------------------------------*/
+#ifdef USE_SLEEP_WAIT
+void TinyWait_us( uint16_t us );
+void TinyWait_ms( uint16_t ms );
+void TinyWait_sec( uint8_t sec );
+#else
+#include "delay.h"
+#ifdef __AVR__
+#include <util/delay.h>
+#define TinyWait_us(us)		TinyWait_spin_us(us)
+#else
+#define TinyWait_us(us)		wait_us(us)		// ホストの delay.h が用意すること
+#endif
+#define TinyWait_ms(ms)		wait_ms(ms)
+#define TinyWait_sec(sec)	wait_sec(sec)
+#endif
+
+#if !defined(USE_SLEEP_WAIT) && defined(__AVR__)
+//========================================================================
+//  待ち時間(us) スピン
+//------------------------------------------------------------------------
+// 引数: uint16_t us : 待ち時間(us)
+// 備考: _delay_us() は定数しか取れないので1usずつ待つ(ループの分だけ長くなる)
+//========================================================================
+static inline void TinyWait_spin_us( uint16_t us )
+{
+    while (us-- != 0)
+    {
+        _delay_us(1);
+    }
+}
+#endif
+
+#endif /* __TINYWAIT_H_ */